@@ -0,0 +1,14 @@
+TEMPLATE = app
+CONFIG += console c++2a
+CONFIG -= app_bundle
+CONFIG -= qt
+
+INCLUDEPATH += ../Binary_Tree_Library
+
+LIBS += -pthread
+
+SOURCES += \
+        async.cpp
+
+HEADERS += \
+    ../Binary_Tree_Library/binarytrees.h
@@ -0,0 +1,259 @@
+#include "binarytrees.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <string>
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * *  Check of the flat-combining async_insert/async_search/async_remove    * *
+ * *  (C++20 coroutines):                                                  * *
+ * *    async [--threads N] [--coroutines C] [--ops K] [--seed S]          * *
+ * *  Every thread starts C coroutines, and every coroutine runs K random  * *
+ * *  operations on its own keys, checking each result against its own     * *
+ * *  std::map. The coroutines are resumed by whichever thread combines,   * *
+ * *  so they move between the threads. Some inserts carry a payload which * *
+ * *  throws when it is moved into the tree: the exception must reach      * *
+ * *  that coroutine only, and the tree must go on working. At the end the * *
+ * *  tree must hold exactly the union of the maps. The exit code is 1 if  * *
+ * *  anything differs, so the target works as a gate                      * *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+   * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef BINARY_TREES_COROUTINES
+#error "The async operations need C++20 coroutines"
+#endif
+
+namespace {
+
+struct Options
+{
+    int threads = 4;
+    int coroutines = 16;
+    int ops = 2000;
+    unsigned seed = 1;
+};
+
+//The payload throws from its move constructor when it has been moved throwAt times - the last move is the one into the node:
+struct Payload
+{
+    int value = 0;
+    int moves = 0;
+    int throwAt = -1;
+
+    Payload() = default;
+    Payload(int value, int throwAt = -1): value(value), throwAt(throwAt)
+    {
+
+    }
+    Payload(const Payload&) = default;
+    Payload& operator = (const Payload&) = default;
+    Payload(Payload&& other): value(other.value), moves(other.moves + 1), throwAt(other.throwAt)
+    {
+        if(moves == throwAt) throw std::runtime_error("poisoned payload");
+    }
+    Payload& operator = (Payload&& other)
+    {
+        value = other.value;
+        moves = other.moves + 1;
+        throwAt = other.throwAt;
+        if(moves == throwAt) throw std::runtime_error("poisoned payload");
+        return *this;
+    }
+};
+
+//A coroutine which starts at once and which nobody awaits; it reports its end through the counter:
+struct Detached
+{
+    struct promise_type
+    {
+        Detached get_return_object()
+        {
+            return {};
+        }
+        std::suspend_never initial_suspend() noexcept
+        {
+            return {};
+        }
+        std::suspend_never final_suspend() noexcept
+        {
+            return {};
+        }
+        void return_void()
+        {
+
+        }
+        void unhandled_exception()
+        {
+            std::terminate();
+        }
+    };
+};
+
+struct Shared
+{
+    std::mutex mtx;
+    std::map<int, int> expected;
+    std::atomic<int> running{0};
+    std::atomic<int> failures{0};
+    std::atomic<int> thrown{0};
+};
+
+void fail(Shared& shared, const char* what, int key)
+{
+    if(shared.failures.fetch_add(1) < 10)
+        std::fprintf(stderr, "  %s differs at key %d\n", what, key);
+}
+
+//The keys of the coroutine are id, id + stride, id + 2 * stride..., so no other coroutine touches them:
+template <class Tree> Detached client(Tree& tree, Shared& shared, int id, int stride, int ops, int throwAt, unsigned seed)
+{
+    std::mt19937 random(seed);
+    std::map<int, int> own;
+
+    for(int i = 0; i < ops; i++)
+    {
+        int key = id + stride * int(random() % 64);
+        int value = int(random() % 1000000);
+
+        switch(random() % 8)
+        {
+        case 0: case 1: case 2:
+        {
+            bool inserted = co_await tree.async_insert(key, Payload(value));
+            if(inserted != own.emplace(key, value).second) fail(shared, "async_insert", key);
+            break;
+        }
+        case 3: case 4:
+        {
+            std::optional<Payload> found = co_await tree.async_search(key);
+            auto it = own.find(key);
+            if(found.has_value() != (it != own.end()) || (found && found->value != it->second)) fail(shared, "async_search", key);
+            break;
+        }
+        case 5: case 6:
+        {
+            bool removed = co_await tree.async_remove(key);
+            if(removed != (own.erase(key) == 1)) fail(shared, "async_remove", key);
+            break;
+        }
+        default:
+        {
+            if(own.count(key)) break; //Only a new node moves the payload into the tree
+
+            bool threw = false;
+            try
+            {
+                co_await tree.async_insert(key, Payload(value, throwAt));
+            }
+            catch(const std::runtime_error&)
+            {
+                threw = true;
+            }
+            if(!threw) fail(shared, "exception of async_insert", key);
+            else shared.thrown++;
+            break;
+        }
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(shared.mtx);
+        shared.expected.insert(own.begin(), own.end());
+    }
+    shared.running--;
+}
+
+//How many times a payload is moved on its way into a node of the tree:
+template <class Tree> int movesIntoNode()
+{
+    Tree tree;
+    int moves = -1;
+    auto probe = [&tree, &moves]() -> Detached
+    {
+        co_await tree.async_insert(1, Payload(0));
+        moves = tree.search(1)->data().moves;
+    };
+    probe();
+
+    return moves;
+}
+
+template <class Tree> bool run(const char* name, const Options& options)
+{
+    Tree tree;
+    Shared shared;
+    int throwAt = movesIntoNode<Tree>();
+    int stride = options.threads * options.coroutines;
+    shared.running = stride;
+
+    auto started = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+    for(int t = 0; t < options.threads; t++)
+        threads.emplace_back([&, t]()
+        {
+            for(int c = 0; c < options.coroutines; c++)
+            {
+                int id = t * options.coroutines + c;
+                client(tree, shared, id, stride, options.ops, throwAt, options.seed * 7919u + unsigned(id));
+            }
+        });
+    for(std::thread& thread : threads)
+        thread.join();
+
+    //The last suspended coroutines are resumed by the last combiner, which may still be busy:
+    while(shared.running.load() > 0)
+        std::this_thread::yield();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    std::map<int, int> stored;
+    tree.forEach([&stored](int key, const Payload& payload) { stored.emplace(key, payload.value); });
+    if(stored != shared.expected) fail(shared, "content of the tree", -1);
+    if(!tree.validate()) fail(shared, "validate()", -1);
+
+    long long operations = 1LL * stride * options.ops;
+    std::printf("%-22s %lld operations, %d exceptions delivered, %.0f ops/s: %s\n", name, operations, shared.thrown.load(),
+                double(operations) / seconds, shared.failures.load() == 0 ? "ok" : "FAILED");
+
+    return shared.failures.load() == 0;
+}
+
+int usage()
+{
+    std::cerr << "Usage: async [--threads N] [--coroutines C] [--ops K] [--seed S]" << std::endl;
+    return 2;
+}
+
+}
+
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    for(int i = 1; i < argc; i++)
+    {
+        std::string argument = argv[i];
+        if(argument == "--threads" && i + 1 < argc) options.threads = std::atoi(argv[++i]);
+        else if(argument == "--coroutines" && i + 1 < argc) options.coroutines = std::atoi(argv[++i]);
+        else if(argument == "--ops" && i + 1 < argc) options.ops = std::atoi(argv[++i]);
+        else if(argument == "--seed" && i + 1 < argc) options.seed = unsigned(std::strtoul(argv[++i], nullptr, 10));
+        else return usage();
+    }
+    if(options.threads < 1 || options.coroutines < 1 || options.ops < 0)
+        return usage();
+
+    bool passed = true;
+    passed = run<abt::SearchThree_p<Payload>>("SearchTree_p", options) && passed;
+    passed = run<abt::ABLTree_p<Payload>>("ABLTree_p", options) && passed;
+    passed = run<abt::RedBlackTree_p<Payload>>("RedBlackTree_p", options) && passed;
+    passed = run<abt::SplayTree_p<Payload>>("SplayTree_p", options) && passed;
+    passed = run<abt::CachedRedBlackTree_p<Payload>>("CachedRedBlackTree_p", options) && passed;
+    passed = run<abt::LazyRedBlackTree_p<Payload>>("LazyRedBlackTree_p", options) && passed;
+
+    return passed ? 0 : 1;
+}
@@ -2,7 +2,44 @@
 #define BINARYTREES_H
 
 #include <mutex>
+#include <thread>
+#include <memory>
+#include <new>
+#include <queue>
+#include <deque>
+#include <functional>
+#include <atomic>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <tuple>
+#include <optional>
+#include <algorithm>
 #include <iostream>
+#include <string>
+#include <cstring>
+#include <cstdio>
+#include <stdexcept>
+#include <exception>
+#include <condition_variable>
+#include <shared_mutex>
+#if __has_include(<unistd.h>) && __has_include(<fcntl.h>)
+#include <unistd.h>
+#include <fcntl.h>
+#define BINARY_TREES_DURABLE
+#endif
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L && __has_include(<coroutine>)
+#include <coroutine>
+#define BINARY_TREES_COROUTINES
+#endif
+#if defined(__linux__) && __has_include(<sys/mman.h>) && __has_include(<sys/syscall.h>)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sched.h>
+#define BINARY_TREES_NUMA
+#endif
 
 
 namespace BinaryTrees {
@@ -19,1303 +56,7349 @@ namespace //Local namespace's names
 typedef bool COLOR;
 const bool RED = true;
 const bool BLACK = false;
-const bool MUTTABLE = true;
-const bool IMMUTTABLE = false;
 }
 
-namespace ThreadingModel
+//Order in which the pool-backed trees lay out their nodes on compact():
+enum class NodeOrder
 {
+    InOrder,
+    BreadthFirst
+};
 
-/* * * * * * * * * * * * * * * * * * * * *
- * *    There is no real functionality   * *
- * *  for organizing the interthreading  * *
- * *        work of the program          * *
- * *        - it's just a stub           * *
-   * * * * * * * * * * * * * * * * * * * * */
-class SingleThreaded
+/* * * * * * * * * * * * * * * * * * * * * * * *
+ * *  Extra data kept in the nodes of the red-   * *
+ * *  black tree and recomputed by its balancing * *
+ * *  code from the children of the node         * *
+   * * * * * * * * * * * * * * * * * * * * * * * */
+namespace Augmentation
 {
-protected:
-    void lock()
+
+class None
+{
+public:
+    class Fields
+    {
+
+    };
+
+    static constexpr bool enabled = false;
+
+    template <class Node> static void update(Node*)
     {
 
     }
 
-    void unlock()
+    template <class Node> static bool valid(Node*)
+    {
+        return true;
+    }
+};
+
+/* * * * * * * * * * * * * * * * * * * * * * *
+ * *  The key of the node is the low end of  * *
+ * *  its interval, data().high - the high   * *
+ * *  end; every node keeps the largest high * *
+ * *  end of its subtree                     * *
+   * * * * * * * * * * * * * * * * * * * * * */
+class Intervals
+{
+public:
+    class Fields
+    {
+        int maxHigh_ = 0;
+
+    public:
+        int max_high()
+        {
+            return maxHigh_;
+        }
+        void set_max_high(int cur_max_high)
+        {
+            maxHigh_ = cur_max_high;
+        }
+    };
+
+    static constexpr bool enabled = true;
+
+    template <class Node> static void update(Node* node)
     {
+        node->set_max_high(maxHigh(node));
+    }
+
+    template <class Node> static bool valid(Node* node)
+    {
+        return node->max_high() == maxHigh(node);
+    }
 
+private:
+    template <class Node> static int maxHigh(Node* node)
+    {
+        int maxHigh = node->data().high;
+        if(node->get_left() != nullptr) maxHigh = std::max(maxHigh, node->get_left()->max_high());
+        if(node->get_right() != nullptr) maxHigh = std::max(maxHigh, node->get_right()->max_high());
+
+        return maxHigh;
     }
 };
 
-/* * * * * * * * * * * * * * * * * * *
- * *    Functionality of blocking    * *
- * *     resources using mutexes     * *
-   * * * * * * * * * * * * * * * * * * */
-class ObjectLevelLockable
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * *
+ * *  How BinaryABLTree and BinaryRedBlackTree    * *
+ * *  remove their nodes                          * *
+   * * * * * * * * * * * * * * * * * * * * * * * * */
+namespace Deletion
 {
-    std::mutex mtx;
 
-protected:
-    void lock()
+//The node is taken out of the tree and the tree is rebalanced at once:
+class Immediate
+{
+public:
+    static constexpr bool lazy = false;
+};
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * *  The node is only marked as a tombstone, which  * *
+ * *  search and iteration skip. Once the tombstones * *
+ * *  make Percent of the nodes, every insert and    * *
+ * *  remove takes up to Steps of them out for real, * *
+ * *  the oldest first                               * *
+   * * * * * * * * * * * * * * * * * * * * * * * * * * */
+template <unsigned Percent = 20, unsigned Steps = 4> class Lazy
+{
+    std::queue<int> pending; //A key revived by insert stays here and is skipped when it is reached
+    size_t tombstones_ = 0;
+    size_t nodes_ = 0; //Tombstones included
+    bool counted_ = true;
+
+public:
+    static constexpr bool lazy = true;
+
+    void added()
     {
-        mtx.lock();
+        nodes_++;
+    }
+    void buried(int key)
+    {
+        pending.push(key);
+        tombstones_++;
+    }
+    void revived()
+    {
+        tombstones_--;
+    }
+    void purged()
+    {
+        tombstones_--;
+        nodes_--;
     }
 
-    void unlock()
+    //The number of tombstones to take out by the current operation:
+    size_t due() const
     {
-        mtx.unlock();
+        return (tombstones_ > 0 && tombstones_ * 100 >= nodes_ * Percent) ? Steps : 0;
+    }
+    //The oldest pending key, false if there are none:
+    bool next(int& key)
+    {
+        if(pending.empty()) return false;
+
+        key = pending.front();
+        pending.pop();
+        return true;
+    }
+
+    size_t tombstones() const
+    {
+        return tombstones_;
+    }
+
+    //The tree was rebuilt by another object (split, join) without tombstones: the nodes are counted again when needed
+    void forget()
+    {
+        counted_ = false;
+    }
+    bool counted() const
+    {
+        return counted_;
+    }
+    void recount(size_t nodes)
+    {
+        nodes_ = nodes;
+        counted_ = true;
+    }
+
+    void clear()
+    {
+        pending = std::queue<int>();
+        tombstones_ = nodes_ = 0;
+        counted_ = true;
     }
 };
 
 }
 
+//Estimated cost of one heap allocation beyond the asked bytes: a size header and the rounding to two words
+constexpr size_t allocationOverhead(size_t bytes)
+{
+    return std::max<size_t>(4 * sizeof(size_t), (bytes + 3 * sizeof(size_t) - 1) / (2 * sizeof(size_t)) * (2 * sizeof(size_t))) - bytes;
+}
 
-/* * * * * * * * * * * * * * * * * * * * * * * *
- * * * * * * * * * * * * * * * * * * * * * * * * *
- * *  Description of specific binary           * *
- * *  trees should be done in accordance       * *
- * *  with the API class of this library.      * *
- * *  These trees must contain the following   * *
- * *  public methods:                          * *
- * *    - search(Node*, int)                   * *
- * *    - getMin(Node*) && getMax(Node*)       * *
- * *    - remove(Node*, int)                   * *
- * *    - printTree(Node*)                     * *
- * *    - deleteTree(Node*&)                   * *
- * *    - copyTree(Node*, Node*)               * *
- * *    - getSizeTree(Node*)                   * *
- * * * * * * * * * * * * * * * * * * * * * * * * *
-   * * * * * * * * * * * * * * * * * * * * * * * */
-template <typename T> class BinarySearchTree
+/* * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * *  Memory of a tree, without walking it - every   * *
+ * *  node of a backend has the same size. What the  * *
+ * *  payloads allocate themselves (the characters   * *
+ * *  of a std::string) is not seen here             * *
+   * * * * * * * * * * * * * * * * * * * * * * * * * * */
+struct MemoryUsage
 {
-protected:
-    class Node
+    size_t nodes = 0;
+    size_t nodeBytes = 0;     //The nodes, with the payloads kept inside them
+    size_t payloadBytes = 0;  //The payloads kept outside of the nodes
+    size_t overheadBytes = 0; //Headers and padding of the allocator, per node and payload
+    size_t reservedBytes = 0; //Memory which does not grow with the nodes: the tree object, unused slots of a pool
+
+    //Grows and shrinks with the nodes - the memory budget of BinaryTrees_API is compared with it:
+    size_t live() const
     {
-        int key_;
-        T* data_;
+        return nodeBytes + payloadBytes + overheadBytes;
+    }
+    size_t total() const
+    {
+        return live() + reservedBytes;
+    }
 
-        Node* left_ = null;
-        Node* right_ = null;
+    //Nodes allocated and keeping their payloads as the policy of Values says:
+    template <class Node, class Values, typename T> static MemoryUsage of(size_t nodes)
+    {
+        typedef typename Values::template Slot<T> Slot;
+
+        MemoryUsage usage;
+        usage.nodes = nodes;
+        usage.nodeBytes = nodes * sizeof(Node);
+        usage.payloadBytes = nodes * Slot::outsideBytes;
+        usage.overheadBytes = nodes * (Values::template nodeOverhead<sizeof(Node), alignof(Node)>() + Slot::outsideOverhead);
+        return usage;
+    }
+};
+
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * *  NUMA placement (Linux): the memory policy is   * *
+ * *  set by the mbind system call itself, so no     * *
+ * *  libnuma is needed. Without NUMA support in the * *
+ * *  kernel every call falls back to the default    * *
+ * *  placement - the node which touches it first    * *
+   * * * * * * * * * * * * * * * * * * * * * * * * * * */
+namespace Numa
+{
+
+constexpr int anyNode = -1;
+constexpr int maxNodes = 64;
+
+//Calls add(first, last) for every range of a sysfs list like "0-1" or "0,2-3":
+template <class Func> void readList(const std::string& path, Func add)
+{
+    FILE* file = std::fopen(path.c_str(), "r");
+    if(file == nullptr) return;
+
+    char list[4096] = {};
+    if(std::fgets(list, sizeof(list), file) != nullptr)
+    {
+        int first = -1, number = -1;
+        for(const char* c = list; ; c++)
+        {
+            if(*c >= '0' && *c <= '9') number = (number < 0 ? 0 : number * 10) + (*c - '0');
+            else if(*c == '-' && number >= 0) { first = number; number = -1; }
+            else
+            {
+                if(number >= 0) add(first >= 0 ? first : number, number);
+                first = number = -1;
+                if(*c == '\0') break;
+            }
+        }
+    }
+    std::fclose(file);
+}
+
+//The number of the nodes up to the last online one, 1 without NUMA:
+inline int nodeCount()
+{
+    int count = 1;
+#ifdef BINARY_TREES_NUMA
+    readList("/sys/devices/system/node/online", [&count](int, int last) { count = std::max(count, last + 1); });
+#endif
+    return std::min(count, maxNodes);
+}
+
+//The node of every CPU, read once - the CPU itself comes from sched_getcpu(), which needs no system call:
+inline const std::vector<int>& cpuNodes()
+{
+    static const std::vector<int> nodes = []
+    {
+        const int maxCpus = 1 << 16;
+        std::vector<int> table;
+#ifdef BINARY_TREES_NUMA
+        for(int node = 0; node < nodeCount(); node++)
+            readList("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist", [&table, node](int first, int last)
+            {
+                last = std::min(last, maxCpus - 1);
+                if(last >= int(table.size())) table.resize(size_t(last) + 1, 0);
+                for(int cpu = first; cpu <= last; cpu++) table[size_t(cpu)] = node;
+            });
+#endif
+        return table;
+    }();
+    return nodes;
+}
+
+//The node of the CPU which runs the calling thread, 0 if it is not known:
+inline int currentNode()
+{
+#ifdef BINARY_TREES_NUMA
+    int cpu = sched_getcpu();
+    const std::vector<int>& nodes = cpuNodes();
+    if(cpu >= 0 && size_t(cpu) < nodes.size())
+        return nodes[size_t(cpu)];
+#endif
+    return 0;
+}
+
+//Asks the kernel to take the pages of the range from the node (preferred - from the others when it is full), false if it refuses:
+inline bool bind(void* memory, size_t bytes, int node)
+{
+#ifdef BINARY_TREES_NUMA
+    if(node >= 0 && node < maxNodes)
+    {
+        const size_t bits = 8 * sizeof(unsigned long);
+        unsigned long mask[maxNodes / bits] = {};
+        mask[node / bits] = 1UL << (node % bits);
+
+        const int preferred = 1; //MPOL_PREFERRED of <linux/mempolicy.h>
+        return syscall(SYS_mbind, memory, bytes, preferred, mask, maxNodes + 1, 0) == 0;
+    }
+#endif
+    (void)memory;
+    (void)bytes;
+    (void)node;
+    return false;
+}
+
+inline int& targetNode()
+{
+    thread_local int node = anyNode;
+    return node;
+}
+
+//While it is alive, the nodes which the thread allocates from the NUMA pools go to the given node:
+class Placement
+{
+    int previous_;
+
+public:
+    explicit Placement(int node): previous_(targetNode())
+    {
+        targetNode() = node;
+    }
+    Placement(const Placement&) = delete;
+    Placement& operator = (const Placement&) = delete;
+    ~Placement()
+    {
+        targetNode() = previous_;
+    }
+};
+
+//The node set by Placement, otherwise the node of the calling thread:
+inline int allocationNode()
+{
+    int node = targetNode();
+    return (node == anyNode) ? currentNode() : node;
+}
+
+}
+
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * *  Where the nodes of BinarySearchTree,           * *
+ * *  BinaryABLTree, BinaryRedBlackTree and          * *
+ * *  BinarySplayTree keep their payloads. A Slot    * *
+ * *  is used like a pointer (*data_), takes the     * *
+ * *  payload by move and frees it with the node.    * *
+ * *  The policy also allocates the nodes themselves  * *
+   * * * * * * * * * * * * * * * * * * * * * * * * * * */
+namespace Values
+{
+
+//The arguments of T's constructor from emplace(), kept until the payload is built where it is stored:
+template <typename T, class... Args> struct Emplace
+{
+    std::tuple<Args&&...> args;
+};
+
+//What the constructor of a node takes its payload from - a T which is moved, or the arguments of emplace():
+template <typename T> T&& payload(T& data)
+{
+    return std::move(data);
+}
+template <typename T, class... Args> T payload(Emplace<T, Args...>& data)
+{
+    return std::make_from_tuple<T>(std::move(data.args));
+}
+
+//The nodes are allocated one by one by the global operator new:
+class NodesOnHeap
+{
+public:
+    template <size_t Bytes, size_t Align> static void* allocateNode()
+    {
+        if constexpr(Align > __STDCPP_DEFAULT_NEW_ALIGNMENT__) return ::operator new(Bytes, std::align_val_t(Align));
+        else return ::operator new(Bytes);
+    }
+    template <size_t Bytes, size_t Align> static void releaseNode(void* node)
+    {
+        if constexpr(Align > __STDCPP_DEFAULT_NEW_ALIGNMENT__) ::operator delete(node, std::align_val_t(Align));
+        else ::operator delete(node);
+    }
+    template <size_t Bytes, size_t Align> static constexpr size_t nodeOverhead()
+    {
+        return allocationOverhead(Bytes);
+    }
+};
+
+//One heap allocation per payload:
+class Heap: public NodesOnHeap
+{
+public:
+    template <typename T> class Slot
+    {
+        T* value_;
 
     public:
-        Node() = delete;
-        explicit Node(int key, T* data): key_(key), data_(new T(*data))
+        static constexpr size_t outsideBytes = sizeof(T);
+        static constexpr size_t outsideOverhead = allocationOverhead(sizeof(T));
+
+        explicit Slot(T&& value): value_(new T(std::move(value)))
         {
 
         }
+        template <class... Args> explicit Slot(Emplace<T, Args...>&& data): value_(new T(payload(data)))
+        {
 
+        }
+        Slot(const Slot&) = delete;
+        Slot& operator = (const Slot&) = delete;
+        ~Slot()
+        {
+            delete value_;
+        }
 
-        void update(const T data)
+        T& operator * () const
         {
-            *data_ = data;
+            return *value_;
+        }
+        void swap(Slot& other)
+        {
+            std::swap(value_, other.value_);
         }
+    };
+};
+
+//The payload is a member of the node, so the node is the only allocation:
+class Inline: public NodesOnHeap
+{
+public:
+    template <typename T> class Slot
+    {
+        mutable T value_;
+
+    public:
+        static constexpr size_t outsideBytes = 0;
+        static constexpr size_t outsideOverhead = 0;
 
-        T& operator = (const T data)
+        explicit Slot(T&& value): value_(std::move(value))
         {
-            *data_ = data;
+
         }
+        template <class... Args> explicit Slot(Emplace<T, Args...>&& data): value_(payload(data))
+        {
 
+        }
+        Slot(const Slot&) = delete;
+        Slot& operator = (const Slot&) = delete;
 
-        //Setters:
-        void set_key(int cur_key)
+        T& operator * () const
+        {
+            return value_;
+        }
+        void swap(Slot& other)
+        {
+            std::swap(value_, other.value_);
+        }
+    };
+};
+
+//Free cells linked through their first word:
+class FreeCells
+{
+    void* head_ = nullptr;
+    size_t count_ = 0;
+
+public:
+    bool empty() const
+    {
+        return count_ == 0;
+    }
+    size_t count() const
+    {
+        return count_;
+    }
+
+    void push(void* cell)
+    {
+        *static_cast<void**>(cell) = head_;
+        head_ = cell;
+        count_++;
+    }
+    void* pop()
+    {
+        void* cell = head_;
+        head_ = *static_cast<void**>(cell);
+        count_--;
+        return cell;
+    }
+
+    //Up to count cells from the front:
+    FreeCells take(size_t count)
+    {
+        FreeCells taken;
+        while(count-- > 0 && count_ > 0)
+            taken.push(pop());
+        return taken;
+    }
+    //Walks only the cells which are added:
+    void splice(FreeCells&& other)
+    {
+        while(!other.empty())
+            push(other.pop());
+    }
+};
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * *
+ * *  The free cells which a thread keeps in front  * *
+ * *  of a shared pool, one list per shelf of the   * *
+ * *  pool: the mutex of the pool is taken once per * *
+ * *  batch of cells instead of once per payload or * *
+ * *  node. When the thread ends its cells go back  * *
+ * *  to the pool by Pool::giveBack(shelf, cells)   * *
+   * * * * * * * * * * * * * * * * * * * * * * * * * */
+template <class Pool, size_t Shelves = 1> class ThreadCells
+{
+public:
+    static constexpr size_t batch = 32; //Cells moved at once; a list keeps at most 2 * batch
+
+    struct Cache
+    {
+        FreeCells lists[Shelves];
+        bool closed = false; //The cells went back already, the thread goes straight to the pool
+    };
+
+    static Cache& local()
+    {
+        //The cache itself is trivially destructible, so a payload freed by a later destructor of the thread still finds it:
+        static thread_local Cache cache;
+        static thread_local Closer closer{cache};
+        return cache;
+    }
+
+private:
+    struct Closer
+    {
+        Cache& cache;
+
+        ~Closer()
+        {
+            for(size_t shelf = 0; shelf < Shelves; shelf++)
+                Pool::instance().giveBack(shelf, std::move(cache.lists[shelf]));
+            cache.closed = true;
+        }
+    };
+};
+
+/* * * * * * * * * * * * * * * * * * * * * * * * *
+ * *  The payloads of one type share chunks which  * *
+ * *  are handed out by bumping an index, a freed  * *
+ * *  payload leaves its cell to the next one;     * *
+ * *  the threads take and return the cells in     * *
+ * *  batches through their ThreadCells            * *
+   * * * * * * * * * * * * * * * * * * * * * * * * */
+template <typename T> class ArenaPool
+{
+    union Cell
+    {
+        void* next;
+        alignas(T) unsigned char bytes[sizeof(T)];
+    };
+    using Cells = ThreadCells<ArenaPool>;
+
+    std::mutex mtx;
+    std::vector<std::unique_ptr<Cell[]>> chunks;
+    size_t chunkSize = 0;
+    size_t used = 0; //Cells of the last chunk handed out
+    FreeCells freeCells;
+
+    ArenaPool() = default;
+
+    //Under mtx:
+    void* carve()
+    {
+        if(used == chunkSize)
+        {
+            chunkSize = (chunkSize == 0) ? 64 : std::min<size_t>(chunkSize * 2, 65536);
+            chunks.emplace_back(new Cell[chunkSize]);
+            used = 0;
+        }
+
+        return &chunks.back()[used++];
+    }
+
+public:
+    static constexpr size_t cellSize = sizeof(Cell);
+
+    //Never destroyed: a tree in static storage may free its payloads after the pool would be gone
+    static ArenaPool& instance()
+    {
+        static ArenaPool* pool = new ArenaPool();
+        return *pool;
+    }
+
+    void* allocate()
+    {
+        typename Cells::Cache& cache = Cells::local();
+        FreeCells& cells = cache.lists[0];
+        if(!cells.empty())
+            return cells.pop();
+
+        std::lock_guard<std::mutex> lock(mtx);
+        size_t wanted = cache.closed ? 1 : Cells::batch;
+        cells.splice(freeCells.take(wanted));
+        while(cells.count() < wanted)
+            cells.push(carve());
+
+        return cells.pop();
+    }
+
+    void release(void* ptr)
+    {
+        typename Cells::Cache& cache = Cells::local();
+        FreeCells& cells = cache.lists[0];
+        cells.push(ptr);
+        if(!cache.closed && cells.count() <= 2 * Cells::batch)
+            return;
+
+        std::lock_guard<std::mutex> lock(mtx);
+        freeCells.splice(cells.take(cache.closed ? cells.count() : Cells::batch));
+    }
+
+    void giveBack(size_t, FreeCells&& cells)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        freeCells.splice(std::move(cells));
+    }
+};
+
+class Arena: public NodesOnHeap
+{
+public:
+    template <typename T> class Slot
+    {
+        T* value_;
+
+    public:
+        static constexpr size_t outsideBytes = sizeof(T);
+        static constexpr size_t outsideOverhead = ArenaPool<T>::cellSize - sizeof(T);
+
+        explicit Slot(T&& value): value_(new (ArenaPool<T>::instance().allocate()) T(std::move(value)))
+        {
+
+        }
+        template <class... Args> explicit Slot(Emplace<T, Args...>&& data): value_(new (ArenaPool<T>::instance().allocate()) T(payload(data)))
+        {
+
+        }
+        Slot(const Slot&) = delete;
+        Slot& operator = (const Slot&) = delete;
+        ~Slot()
+        {
+            value_->~T();
+            ArenaPool<T>::instance().release(value_);
+        }
+
+        T& operator * () const
+        {
+            return *value_;
+        }
+        void swap(Slot& other)
+        {
+            std::swap(value_, other.value_);
+        }
+    };
+};
+
+//Small payloads go to the node, the larger ones to the arena:
+template <size_t InlineLimit = 2 * sizeof(void*)> class Auto: public NodesOnHeap
+{
+public:
+    template <typename T> using Slot = typename std::conditional<(sizeof(T) <= InlineLimit), Inline::Slot<T>, Arena::Slot<T>>::type;
+};
+
+//Where NodePool takes its chunks from - map(bytes) returns memory aligned on bytes:
+class SmallPages
+{
+public:
+    static char* map(size_t bytes)
+    {
+#ifdef BINARY_TREES_NUMA
+        //Twice the size is mapped and cut down to one aligned chunk:
+        char* mapped = static_cast<char*>(mmap(nullptr, 2 * bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+        if(mapped != MAP_FAILED)
+        {
+            char* chunk = mapped + (bytes - uintptr_t(mapped) % bytes) % bytes;
+            if(chunk != mapped) munmap(mapped, size_t(chunk - mapped));
+            if(chunk + bytes != mapped + 2 * bytes) munmap(chunk + bytes, size_t(mapped + bytes - chunk));
+            return chunk;
+        }
+#endif
+        return static_cast<char*>(::operator new(bytes, std::align_val_t(bytes)));
+    }
+};
+
+//2 MB pages: the explicit ones if the kernel has a reserve of them (vm.nr_hugepages), otherwise transparent ones by madvise():
+class HugePages
+{
+public:
+    static char* map(size_t bytes)
+    {
+#if defined(BINARY_TREES_NUMA) && defined(MAP_HUGETLB)
+        void* mapped = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if(mapped != MAP_FAILED) return static_cast<char*>(mapped); //Aligned on the size of the huge page
+#endif
+        char* chunk = SmallPages::map(bytes);
+#if defined(BINARY_TREES_NUMA) && defined(MADV_HUGEPAGE)
+        madvise(chunk, bytes, MADV_HUGEPAGE); //Fails harmlessly without transparent huge pages
+#endif
+        return chunk;
+    }
+};
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * *  Cells for the nodes of one size, densely packed  * *
+ * *  in chunks of 2 MB, per NUMA node. The chunks are * *
+ * *  aligned on their size, so a freed cell finds its * *
+ * *  chunk - and the node the chunk was bound to - by * *
+ * *  its own address. The threads take and return    * *
+ * *  the cells in batches through their ThreadCells   * *
+   * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+template <size_t Bytes, size_t Align, class Pages = SmallPages> class NodePool
+{
+public:
+    static constexpr size_t chunkBytes = size_t(2) << 20;
+    static constexpr size_t cellBytes = (std::max(Bytes, sizeof(void*)) + Align - 1) / Align * Align;
+
+private:
+    static constexpr size_t headerBytes = (sizeof(int) + Align - 1) / Align * Align; //The number of the shelf
+    static constexpr size_t cellsPerChunk = (chunkBytes - headerBytes) / cellBytes;
+    static_assert(cellsPerChunk > 0, "The node does not fit into a chunk");
+
+    struct Shelf //The cells of one NUMA node
+    {
+        std::mutex mtx;
+        FreeCells freeCells;
+        char* next = nullptr;
+        char* end = nullptr;
+    };
+    using Cells = ThreadCells<NodePool, Numa::maxNodes + 1>;
+
+    Shelf shelves[Numa::maxNodes + 1]; //The last one is for the chunks bound to no node
+
+    NodePool() = default;
+
+    //Under the mutex of the shelf:
+    void* carve(int node)
+    {
+        Shelf& shelf = shelves[node];
+        if(shelf.next == shelf.end)
+        {
+            char* chunk = Pages::map(chunkBytes);
+            if(node != Numa::maxNodes)
+                Numa::bind(chunk, chunkBytes, node); //Before the first touch, so the pages come from the node
+            *reinterpret_cast<int*>(chunk) = node;
+
+            shelf.next = chunk + headerBytes;
+            shelf.end = shelf.next + cellsPerChunk * cellBytes;
+        }
+
+        void* cell = shelf.next;
+        shelf.next += cellBytes;
+        return cell;
+    }
+
+public:
+    //Never destroyed, like ArenaPool
+    static NodePool& instance()
+    {
+        static NodePool* pool = new NodePool();
+        return *pool;
+    }
+
+    //Numa::anyNode - the chunk is left to the default placement:
+    void* allocate(int node)
+    {
+        if(node < 0 || node >= Numa::maxNodes) node = Numa::maxNodes;
+        typename Cells::Cache& cache = Cells::local();
+        FreeCells& cells = cache.lists[node];
+        if(!cells.empty())
+            return cells.pop();
+
+        Shelf& shelf = shelves[node];
+        std::lock_guard<std::mutex> lock(shelf.mtx);
+        size_t wanted = cache.closed ? 1 : Cells::batch;
+        cells.splice(shelf.freeCells.take(wanted));
+        while(cells.count() < wanted)
+            cells.push(carve(node));
+
+        return cells.pop();
+    }
+
+    void release(void* cell)
+    {
+        int node = *reinterpret_cast<int*>(uintptr_t(cell) / chunkBytes * chunkBytes);
+        typename Cells::Cache& cache = Cells::local();
+        FreeCells& cells = cache.lists[node];
+        cells.push(cell);
+        if(!cache.closed && cells.count() <= 2 * Cells::batch)
+            return;
+
+        Shelf& shelf = shelves[node];
+        std::lock_guard<std::mutex> lock(shelf.mtx);
+        shelf.freeCells.splice(cells.take(cache.closed ? cells.count() : Cells::batch));
+    }
+
+    void giveBack(size_t node, FreeCells&& cells)
+    {
+        Shelf& shelf = shelves[node];
+        std::lock_guard<std::mutex> lock(shelf.mtx);
+        shelf.freeCells.splice(std::move(cells));
+    }
+};
+
+//The nodes go to the NUMA node chosen by Numa::Placement, or to the node of the allocating thread; Payloads keep the payloads (the inline ones go with the node):
+template <class Payloads = Auto<>, class Pages = SmallPages> class NumaLocal: public Payloads
+{
+public:
+    template <size_t Bytes, size_t Align> static void* allocateNode()
+    {
+        return NodePool<Bytes, Align, Pages>::instance().allocate(Numa::allocationNode());
+    }
+    template <size_t Bytes, size_t Align> static void releaseNode(void* node)
+    {
+        NodePool<Bytes, Align, Pages>::instance().release(node);
+    }
+    template <size_t Bytes, size_t Align> static constexpr size_t nodeOverhead()
+    {
+        return NodePool<Bytes, Align, Pages>::cellBytes - Bytes;
+    }
+};
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * *
+ * *  The nodes are packed into huge pages, so a   * *
+ * *  search over a large tree needs far fewer TLB * *
+ * *  entries; they are bound to a NUMA node only  * *
+ * *  under Numa::Placement. With Payloads =       * *
+ * *  Inline the payloads are packed there too     * *
+   * * * * * * * * * * * * * * * * * * * * * * * * * */
+template <class Payloads = Auto<>> class HugePageNodes: public Payloads
+{
+public:
+    template <size_t Bytes, size_t Align> static void* allocateNode()
+    {
+        return NodePool<Bytes, Align, HugePages>::instance().allocate(Numa::targetNode());
+    }
+    template <size_t Bytes, size_t Align> static void releaseNode(void* node)
+    {
+        NodePool<Bytes, Align, HugePages>::instance().release(node);
+    }
+    template <size_t Bytes, size_t Align> static constexpr size_t nodeOverhead()
+    {
+        return NodePool<Bytes, Align, HugePages>::cellBytes - Bytes;
+    }
+};
+
+}
+
+//Data of the interval trees - the low end of the interval is the key of the node:
+template <typename V> struct Interval
+{
+    int high;
+    V value;
+};
+template <typename V> std::ostream& operator << (std::ostream& out, const Interval<V>& interval)
+{
+    return out << "[.., " << interval.high << "] " << interval.value;
+}
+
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * *
+ * *  Keys whose nodes were moved to other nodes or * *
+ * *  freed as a side effect of an operation on a   * *
+ * *  tree (payload swaps of rotations, the copy of * *
+ * *  the successor on remove, growth of a pool).   * *
+ * *  The trees collect them only while somebody    * *
+ * *  watches - the lookup cache of BinaryTrees_API * *
+   * * * * * * * * * * * * * * * * * * * * * * * * * */
+class Relocations
+{
+public:
+    std::vector<int> keys;
+    bool all = false;
+
+    void clear()
+    {
+        keys.clear();
+        all = false;
+    }
+};
+
+class RelocationReporter
+{
+    Relocations* relocations_ = nullptr;
+
+protected:
+    void watchRelocations(Relocations* relocations)
+    {
+        relocations_ = relocations;
+    }
+
+    void relocated(int key)
+    {
+        if(relocations_ != nullptr)
+            relocations_->keys.push_back(key);
+    }
+
+    void relocatedAll()
+    {
+        if(relocations_ != nullptr)
+            relocations_->all = true;
+    }
+};
+
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * *
+ * *  Caches of the search results which can be    * *
+ * *  placed in front of the trees by the API      * *
+   * * * * * * * * * * * * * * * * * * * * * * * * * */
+namespace LookupCache
+{
+
+class None
+{
+public:
+    template <class Node> class Table
+    {
+    public:
+        static constexpr bool enabled = false;
+
+        Node* find(int)
+        {
+            return nullptr;
+        }
+        void store(int, Node*)
+        {
+
+        }
+        void erase(int)
+        {
+
+        }
+        void clear()
+        {
+
+        }
+    };
+};
+
+/* * * * * * * * * * * * * * * * * * * * * * *
+ * *  Every key has exactly one place in the * *
+ * *  table, so a lookup is a single probe   * *
+ * *  and a new key simply replaces the old  * *
+   * * * * * * * * * * * * * * * * * * * * * */
+template <size_t Size = 1024> class DirectMapped
+{
+public:
+    template <class Node> class Table
+    {
+        struct Entry
+        {
+            int key = 0;
+            Node* node = nullptr;
+        };
+
+        Entry entries[Size];
+        size_t hits_ = 0;
+        size_t misses_ = 0;
+
+        static size_t slot(int key)
+        {
+            return size_t(uint32_t(key) * 2654435761u) % Size;
+        }
+
+    public:
+        static constexpr bool enabled = true;
+
+        Node* find(int key)
+        {
+            Entry& entry = entries[slot(key)];
+            if(entry.node != nullptr && entry.key == key)
+            {
+                hits_++;
+                return entry.node;
+            }
+
+            misses_++;
+            return nullptr;
+        }
+        void store(int key, Node* node)
+        {
+            entries[slot(key)].key = key;
+            entries[slot(key)].node = node;
+        }
+        void erase(int key)
+        {
+            if(entries[slot(key)].key == key)
+                entries[slot(key)].node = nullptr;
+        }
+        void clear()
+        {
+            for(Entry& entry : entries)
+                entry.node = nullptr;
+        }
+
+        size_t hits()
+        {
+            return hits_;
+        }
+        size_t misses()
+        {
+            return misses_;
+        }
+    };
+};
+
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * *
+ * *  How the persistent tree frees the nodes   * *
+ * *  which no version references any more      * *
+   * * * * * * * * * * * * * * * * * * * * * * * */
+namespace Reclamation
+{
+
+//The node is freed as soon as its last reference is gone:
+class Immediate
+{
+public:
+    static constexpr bool deferred = false;
+
+    template <class Node> static void retire(Node* node)
+    {
+        delete node;
+    }
+};
+
+/* * * * * * * * * * * * * * * * * * * * * * * * *
+ * *  Epoch-based reclamation: a reader pins the  * *
+ * *  current epoch in one of the slots and the   * *
+ * *  retired nodes are freed only two epochs     * *
+ * *  later, when no reader can still see them.   * *
+ * *  When all the slots are taken, the readers   * *
+ * *  share one more slot, which keeps the epoch  * *
+ * *  of the first of them until the last leaves  * *
+   * * * * * * * * * * * * * * * * * * * * * * * * */
+template <size_t Readers = 64> class Epochs
+{
+    static constexpr uint64_t idle = UINT64_MAX;
+    static constexpr size_t collectAfter = 256;
+
+    struct alignas(64) Slot
+    {
+        std::atomic<uint64_t> epoch{idle};
+    };
+
+    struct Retired
+    {
+        uint64_t epoch;
+        void* node;
+        void (*destroy)(void*);
+    };
+
+    std::atomic<uint64_t> epoch_{0};
+    Slot slots_[Readers + 1]; //slots_[Readers] is the shared one
+
+    std::mutex sharedMutex;
+    size_t sharedReaders = 0;
+
+    std::mutex retiredMutex;
+    std::vector<Retired> retired_;
+    size_t collectAt = collectAfter; //Twice the number of the nodes left by the last collect, so a pinned epoch doesn't make every retire() scan the list
+
+public:
+    static constexpr bool deferred = true;
+
+    Epochs() = default;
+    Epochs(const Epochs&) = delete;
+    Epochs& operator = (const Epochs&) = delete;
+    ~Epochs()
+    {
+        for(Retired& entry : retired_)
+            entry.destroy(entry.node);
+    }
+
+    //Returns the slot which must be passed to leave():
+    size_t enter()
+    {
+        size_t slot = std::hash<std::thread::id>()(std::this_thread::get_id()) % Readers;
+        for(size_t tried = 0; tried < Readers; tried++, slot = (slot + 1) % Readers)
+        {
+            uint64_t expected = idle;
+            if(slots_[slot].epoch.load(std::memory_order_relaxed) != idle ||
+               !slots_[slot].epoch.compare_exchange_strong(expected, epoch_.load())) continue;
+
+            pin(slot);
+            return slot;
+        }
+
+        //An older epoch than the own one only holds back more nodes, so the later readers keep the epoch of the first:
+        std::lock_guard<std::mutex> lock(sharedMutex);
+        if(sharedReaders++ == 0)
+        {
+            slots_[Readers].epoch.store(epoch_.load());
+            pin(Readers);
+        }
+
+        return Readers;
+    }
+
+    void leave(size_t slot)
+    {
+        if(slot < Readers)
+        {
+            slots_[slot].epoch.store(idle, std::memory_order_release);
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(sharedMutex);
+        if(--sharedReaders == 0)
+            slots_[Readers].epoch.store(idle, std::memory_order_release);
+    }
+
+    template <class Node> void retire(Node* node)
+    {
+        std::lock_guard<std::mutex> lock(retiredMutex);
+        retired_.push_back({epoch_.load(), node, [](void* ptr){ delete static_cast<Node*>(ptr); }});
+
+        if(retired_.size() >= collectAt)
+        {
+            collect();
+            collectAt = std::max(collectAfter, 2 * retired_.size());
+        }
+    }
+
+private:
+    //The epoch could have moved on between the load and the claim of the slot:
+    void pin(size_t slot)
+    {
+        uint64_t current;
+        while((current = epoch_.load()) != slots_[slot].epoch.load(std::memory_order_relaxed))
+            slots_[slot].epoch.store(current);
+    }
+
+    //Called under retiredMutex:
+    void collect()
+    {
+        uint64_t current = epoch_.load();
+        bool quiet = true;
+        for(Slot& slot : slots_)
+        {
+            uint64_t pinned = slot.epoch.load();
+            if(pinned != idle && pinned != current) quiet = false;
+        }
+        if(quiet)
+            epoch_.compare_exchange_strong(current, current + 1);
+
+        current = epoch_.load();
+        auto kept = std::partition(retired_.begin(), retired_.end(), [current](const Retired& entry){ return entry.epoch + 2 > current; });
+        for(auto entry = kept; entry != retired_.end(); ++entry)
+            entry->destroy(entry->node);
+        retired_.erase(kept, retired_.end());
+    }
+};
+
+}
+
+
+namespace ThreadingModel
+{
+
+/* * * * * * * * * * * * * * * * * * * * *
+ * *    There is no real functionality   * *
+ * *  for organizing the interthreading  * *
+ * *        work of the program          * *
+ * *        - it's just a stub           * *
+   * * * * * * * * * * * * * * * * * * * * */
+class SingleThreaded
+{
+protected:
+    void lock()
+    {
+
+    }
+
+    void unlock()
+    {
+
+    }
+};
+
+/* * * * * * * * * * * * * * * * * * *
+ * *    Functionality of blocking    * *
+ * *     resources using mutexes     * *
+   * * * * * * * * * * * * * * * * * * */
+class ObjectLevelLockable
+{
+    std::mutex mtx;
+
+protected:
+    void lock()
+    {
+        mtx.lock();
+    }
+
+    void unlock()
+    {
+        mtx.unlock();
+    }
+};
+
+}
+
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * *  Which nodes BinaryTrees_API removes when its   * *
+ * *  memory budget is exceeded. The policy is told  * *
+ * *  about every use and removal of a key and names * *
+ * *  the next victim; minKey() gives the smallest   * *
+ * *  key of the (not empty) tree                    * *
+   * * * * * * * * * * * * * * * * * * * * * * * * * * */
+namespace Eviction
+{
+
+//No budget can be set:
+class None
+{
+public:
+    static constexpr bool enabled = false;
+    static constexpr bool recency = false; //The policy must see the keys again after the tree was rebuilt
+
+    void used(int)
+    {
+
+    }
+    void forgotten(int)
+    {
+
+    }
+    void clear()
+    {
+
+    }
+    void account(MemoryUsage&) const
+    {
+
+    }
+    template <class MinKey> int victim(MinKey minKey)
+    {
+        return minKey();
+    }
+};
+
+//The smallest key goes first - with append() it is the oldest node, and the order costs nothing to keep:
+class OldestKey: public None
+{
+public:
+    static constexpr bool enabled = true;
+};
+
+/* * * * * * * * * * * * * * * * * * * * * * * * *
+ * *  The key which was inserted or found least  * *
+ * *  recently goes first. The nodes of the      * *
+ * *  backends move their keys and payloads on   * *
+ * *  rebalancing, so the list is linked through * *
+ * *  the keys in a table next to the tree       * *
+   * * * * * * * * * * * * * * * * * * * * * * * * */
+class LeastRecentlyUsed
+{
+    struct Link
+    {
+        int older;
+        int newer;
+    };
+
+    std::unordered_map<int, Link> links_;
+    int oldest_ = 0;
+    int newest_ = 0;
+
+    void unlink(const Link& link, int key)
+    {
+        if(key == oldest_) oldest_ = link.newer;
+        else links_.at(link.older).newer = link.newer;
+
+        if(key == newest_) newest_ = link.older;
+        else links_.at(link.newer).older = link.older;
+    }
+
+public:
+    static constexpr bool enabled = true;
+    static constexpr bool recency = true;
+
+    void used(int key)
+    {
+        auto found = links_.find(key);
+        if(found != links_.end())
+        {
+            if(key == newest_) return;
+            unlink(found->second, key);
+        }
+        else
+            found = links_.emplace(key, Link()).first;
+
+        if(links_.size() == 1) oldest_ = key;
+        else links_.at(newest_).newer = key;
+
+        found->second.older = newest_;
+        newest_ = key;
+    }
+
+    void forgotten(int key)
+    {
+        auto found = links_.find(key);
+        if(found == links_.end()) return;
+
+        unlink(found->second, key);
+        links_.erase(found);
+    }
+
+    void clear()
+    {
+        links_.clear();
+    }
+
+    //The entries grow with the keys, so they are a part of the live memory; the buckets stay at the largest size the table had:
+    void account(MemoryUsage& usage) const
+    {
+        const size_t entry = sizeof(std::pair<const int, Link>) + 2 * sizeof(void*); //The link to the next entry and the cached hash
+        usage.overheadBytes += links_.size() * (entry + allocationOverhead(entry));
+        usage.reservedBytes += links_.bucket_count() * sizeof(void*);
+    }
+
+    template <class MinKey> int victim(MinKey minKey)
+    {
+        return links_.empty() ? minKey() : oldest_;
+    }
+};
+
+}
+
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * *  Compile-time behaviour of BinaryTrees_API: a  * *
+ * *  bundle derives from Default and overrides the * *
+ * *  constants it needs; every switched off        * *
+ * *  feature is cut out by if constexpr            * *
+   * * * * * * * * * * * * * * * * * * * * * * * * * * */
+namespace TreeTraits
+{
+
+//What insert() does with a key which is already in the tree:
+enum class Duplicates
+{
+    Reject,   //Nothing is changed, insert() returns false
+    Overwrite //The payload is replaced, insert() still returns false
+};
+
+struct Default
+{
+    static constexpr Duplicates duplicates = Duplicates::Reject;
+    static constexpr bool throwingSearch = true; //search() throws std::out_of_range on a missing key instead of returning null
+    static constexpr bool trackedSize = true;    //size() is O(1), otherwise every call counts the nodes
+    static constexpr bool stats = false;         //stats() counts the operations
+    static constexpr bool polymorphic = true;    //The destructor is virtual
+    typedef Eviction::None eviction;             //What goes when the memory budget is exceeded
+};
+
+//For a latency-critical single-threaded tree: no exceptions, no counters, no virtual destructor
+struct Lean: Default
+{
+    static constexpr bool throwingSearch = false;
+    static constexpr bool trackedSize = false;
+    static constexpr bool polymorphic = false;
+};
+
+struct Profiled: Default
+{
+    static constexpr bool stats = true;
+};
+
+//For a tree used as a bounded cache - see BinaryTrees_API::set_memory_budget()
+struct Bounded: Default
+{
+    typedef Eviction::LeastRecentlyUsed eviction;
+};
+
+struct Counters
+{
+    size_t inserts = 0;
+    size_t removes = 0;
+    size_t hits = 0;   //Lookups which found the key
+    size_t misses = 0;
+    size_t evictions = 0; //Removes made by the memory budget, counted in removes too
+};
+struct NoCounters
+{
+
+};
+
+class Polymorphic
+{
+public:
+    virtual ~Polymorphic() = default;
+};
+class Monomorphic
+{
+
+};
+
+}
+
+
+/* * * * * * * * * * * * * * * * * * * * * * * *
+ * * * * * * * * * * * * * * * * * * * * * * * * *
+ * *  Description of specific binary           * *
+ * *  trees should be done in accordance       * *
+ * *  with the API class of this library.      * *
+ * *  These trees must contain the following   * *
+ * *  public methods:                          * *
+ * *    - search(Node*, int)                   * *
+ * *    - getMin(Node*) && getMax(Node*)       * *
+ * *    - remove(Node*, int)                   * *
+ * *    - appendTree(Node*&, int, T*)          * *
+ * *    - printTree(Node*)                     * *
+ * *    - deleteTree(Node*&)                   * *
+ * *    - copyTree(Node*, Node*)               * *
+ * *    - traverseTree(Node*, Func&)           * *
+ * *    - getSizeTree(Node*)                   * *
+ * * * * * * * * * * * * * * * * * * * * * * * * *
+   * * * * * * * * * * * * * * * * * * * * * * * */
+template <typename T, class Values = Values::Auto<>> class BinarySearchTree: protected RelocationReporter
+{
+protected:
+    class Node
+    {
+        int key_;
+        typename Values::template Slot<T> data_;
+
+        Node* left_ = null;
+        Node* right_ = null;
+
+    public:
+        Node() = delete;
+        template <class Data> explicit Node(int key, Data* data): key_(key), data_(std::move(*data))
+        {
+
+        }
+
+
+        void update(const T& data)
+        {
+            *data_ = data;
+        }
+
+        T& operator = (const T& data)
+        {
+            *data_ = data;
+            return *data_;
+        }
+
+
+        //Setters:
+        void set_key(int cur_key)
+        {
+            key_ = cur_key;
+        }
+        void set_data(T* data)
+        {
+            *data_ = *data;
+        }
+        void set_left(Node* cur_left)
+        {
+            left_ = cur_left;
+        }
+        void set_right(Node* cur_right)
+        {
+            right_ = cur_right;
+        }
+
+        //Getters:
+        int key()
+        {
+            return key_;
+        }
+        const T& data()
+        {
+            return* data_;
+        }
+        Node* get_left()
+        {
+            return left_;
+        }
+        Node* get_right()
+        {
+            return right_;
+        }
+
+
+protected:
+        template <typename U = T>
+        void operator delete(void* ptr, U); //! Либо вместо U использовать - typename std::enable_if<!std::is_same<U, BinarySearchTree>::value>::type* = nullptr - это механизм позволяющий контролировать, что объекту, который захочет удалить Node, разрешено это делать - на самом деле не работает в данном случае, так что это просто как вариант действий
+
+        static void* operator new(size_t)
+        {
+            return Values::template allocateNode<sizeof(Node), alignof(Node)>();
+        }
+        static void operator delete(void* node)
+        {
+            Values::template releaseNode<sizeof(Node), alignof(Node)>(node);
+        }
+
+        static void destroy(Node* node)
+        {
+            node->~Node();
+            operator delete(node);
+        }
+
+        friend class BinarySearchTree;
+    };
+    static Node *null;
+
+
+    template <class Data> void insert(Node*& node, int key, Data* __restrict data)
+    {
+        if(node == null) node = maxNode_ = new Node(key, data);
+        else
+        {
+            insert_process(node, key, data);
+            if(key >= maxNode_->key()) maxNode_ = maxNode_->get_right();
+        }
+    }
+
+    //The key is larger than all keys of the tree, so the node goes right after the largest one without a descent:
+    void appendTree(Node*& node, int key, T* __restrict data)
+    {
+        if(node == null) node = maxNode_ = new Node(key, data);
+        else
+        {
+            maxNode_->set_right(new Node(key, data));
+            maxNode_ = maxNode_->get_right();
+        }
+    }
+
+    //Поиск узлов дерева:
+    Node* search(Node* node, int key)
+    {
+        if(node == null) return null;
+        if(node->key() == key) return node;
+
+        return (key < node->key()) ? search(node->get_left(), key) : search(node->get_right(), key);
+    }
+
+    Node* getMin(Node* node)
+    {
+        if(node == null) return null;
+        if(node->get_left() == null) return node;
+        return getMin(node->get_left());
+    }
+
+    Node* getMax(Node* node)
+    {
+        if(node == null) return null;
+        if(node->get_right() == null) return node;
+        return getMax(node->get_right());
+    }
+
+    void remove(Node*& node, int key)
+    {
+        bool removesMax = (maxNode_ != null && key == maxNode_->key());
+
+        node = remove_process(node, key);
+        if(removesMax) maxNode_ = getMax(node);
+    }
+
+    //Changes the payload of the node in place, the node stays where it is:
+    template <class Func> Node* modify(Node*&, Node* node, Func& change)
+    {
+        change(*node->data_);
+        return node;
+    }
+
+    //Дополнительный функционал дерева:
+    void printTree(Node* node)
+    {
+        if(node == null) return;
+        printTree(node->get_right());
+        printTree(node->get_left());
+        std::cout << "Node's key: " << node->key() << "  -  Node's value: " << node->data() << "  -  Node's adress: " << node << std::endl;
+    }
+
+    void deleteTree(Node*& node)
+    {
+        if(node == null) return;
+
+        Node* delLeft = node->get_left();
+        Node* delRight = node->get_right();
+
+        deleteTree(delLeft);
+        deleteTree(delRight);
+
+        Node::destroy(node);
+        node = null;
+        maxNode_ = null;
+    }
+
+    void copyTree(Node* node_donor, Node* node_recipient)
+    {
+        if(node_donor == null) return;
+        copyTree(node_donor->get_right(), node_recipient->get_right());
+        copyTree(node_donor->get_left(), node_recipient->get_left());
+        T donor_data = node_donor->data();
+        node_recipient->set_key(node_donor->key());
+        node_recipient->set_data(&donor_data);
+    }
+
+    template <class Func> void traverseTree(Node* node, Func& visit)
+    {
+        if(node == null) return;
+        traverseTree(node->get_left(), visit);
+        visit(node);
+        traverseTree(node->get_right(), visit);
+    }
+
+    int getSizeTree(Node* node)
+    {
+        int countNodes = 0;
+        checkSizeTree_process(node, &countNodes);
+
+        return countNodes;
+    }
+
+    //The nodes are not walked - they all have the same size:
+    MemoryUsage memoryUsage(Node*, size_t nodes)
+    {
+        return MemoryUsage::of<Node, Values, T>(nodes);
+    }
+
+    //The keys grow in the order of the tree and the largest node is the remembered one; without recursion, as the tree may be a list:
+    bool validate(Node* tree)
+    {
+        std::vector<Node*> path;
+        Node* node = tree;
+        Node* previous = null;
+
+        while(node != null || !path.empty())
+        {
+            for(; node != null; node = node->get_left())
+                path.push_back(node);
+
+            node = path.back();
+            path.pop_back();
+            if(previous != null && previous->key() >= node->key()) return false;
+
+            previous = node;
+            node = node->get_right();
+        }
+
+        return maxNode_ == previous;
+    }
+
+
+private:
+    Node* maxNode_ = null; //The node with the largest key
+
+
+    template <class Data> void insert_process(Node* __restrict node, int key, Data* __restrict data)
+    {
+        if(key < node->key())
+        {
+            if(node->get_left() == null) node->set_left(new Node(key, data));
+            else insert_process(node->get_left(), key, data);
+        }
+        else if(key >= node->key())
+        {
+            if(node->get_right() == null) node->set_right(new Node(key, data));
+            else insert_process(node->get_right(), key, data);
+        }
+    }
+
+    Node* remove_process(Node *node, int key)
+    {
+        if(node == null) return null;
+        else if(key < node->key()) node->set_left(remove_process(node->get_left(), key));
+        else if(key > node->key()) node->set_right(remove_process(node->get_right(), key));
+        else
+        {
+            if(node->get_left() == null && node->get_right() == null)
+            {
+                Node::destroy(node);
+                node = null;
+            }
+            else if(node->get_left() == null || node->get_right() == null)
+            {
+                Node* temp = node;
+                node = (node->get_left() == null) ? node->get_right() : node->get_left();
+
+                Node::destroy(temp);
+            }
+            else
+            {
+                Node* maxInLeft = getMax(node->get_left());
+                relocated(maxInLeft->key());
+
+                node->set_key(maxInLeft->key());
+                node->data_.swap(maxInLeft->data_);
+                node->set_left(remove_process(node->get_left(), node->key()));
+            }
+        }
+
+        return node;
+    }
+
+    void checkSizeTree_process(Node *node, int *count)
+    {
+        if(node == null) return;
+        checkSizeTree_process(node->get_left(), count);
+        *count += 1;
+        checkSizeTree_process(node->get_right(), count);
+    }
+
+};
+template <typename T, class Values> typename BinarySearchTree<T, Values>::Node *BinarySearchTree<T, Values>::null = nullptr;
+
+template <typename T, class Deletion = Deletion::Immediate, class Values = Values::Auto<>> class BinaryABLTree: protected RelocationReporter
+{
+protected:
+    class Node
+    {
+        int key_;
+        bool dead_ = false; //A tombstone of Deletion::Lazy, which moves together with the key
+        typename Values::template Slot<T> data_;
+        size_t height_ = 0;
+
+        Node* left_ = null;
+        Node* right_ = null;
+
+
+    public:
+        Node() = delete;
+        template <class Data> explicit Node(int key, Data* data): key_(key), data_(std::move(*data))
+        {
+
+        }
+
+
+        void update(const T& data)
+        {
+            *data_ = data;
+        }
+
+        T& operator = (const T& data)
+        {
+            *data_ = data;
+            return *data_;
+        }
+
+        //Setters:
+        void set_key(int cur_key)
+        {
+            key_ = cur_key;
+        }
+        void set_data(T* data)
+        {
+            *data_ = *data;
+        }
+        void set_left(Node* cur_left)
+        {
+            left_ = cur_left;
+        }
+        void set_right(Node* cur_right)
+        {
+            right_ = cur_right;
+        }
+
+        //Getters:
+        int key()
+        {
+            return key_;
+        }
+        const T& data()
+        {
+            return* data_;
+        }
+        Node* get_left()
+        {
+            return left_;
+        }
+        Node* get_right()
+        {
+            return right_;
+        }
+
+
+    protected:
+        template <typename U = T>
+        void operator delete(void* ptr, U); //! Либо вместо U использовать - typename std::enable_if<!std::is_same<U, BinarySearchTree>::value>::type* = nullptr - это механизм позволяющий контролировать, что объекту, который захочет удалить Node, разрешено это делать - на самом деле не работает в данном случае, так что это просто как вариант действий
+
+        static void* operator new(size_t)
+        {
+            return Values::template allocateNode<sizeof(Node), alignof(Node)>();
+        }
+        static void operator delete(void* node)
+        {
+            Values::template releaseNode<sizeof(Node), alignof(Node)>(node);
+        }
+
+        static void destroy(Node* node)
+        {
+            node->~Node();
+            operator delete(node);
+        }
+
+        friend class BinaryABLTree;
+    };
+    static Node *null;
+
+
+    template <class Data> void insert(Node*& node, int key, Data* __restrict data)
+    {
+        if constexpr(Deletion::lazy)
+        {
+            Node* buried = locate(node, key);
+            if(buried != null)
+            {
+                *buried->data_ = BinaryTrees::Values::payload(*data);
+                buried->dead_ = false;
+                deletion.revived();
+                purge_due(node);
+                return;
+            }
+            deletion.added();
+        }
+
+        if(node == null) node = new Node(key, data);
+        else insert_process(node, key, data);
+
+        if constexpr(Deletion::lazy)
+            purge_due(node);
+    }
+
+    //The heights of the whole right spine change, so the appended key still goes down from the root:
+    void appendTree(Node*& node, int key, T* __restrict data)
+    {
+        insert(node, key, data);
+    }
+
+    void remove(Node*& node, int key)
+    {
+        if constexpr(Deletion::lazy)
+        {
+            Node* target = locate(node, key);
+            if(target == null || target->dead_) return;
+
+            target->dead_ = true;
+            deletion.buried(key);
+            purge_due(node);
+        }
+        else
+            node = remove_process(node, key);
+    }
+
+    //Takes up to steps tombstones out of the tree, returns the number of the ones left (always none without Deletion::Lazy)
+    size_t purge(Node*& tree, size_t steps)
+    {
+        if constexpr(!Deletion::lazy) return 0;
+        else
+        {
+            int key;
+            for(; steps > 0 && deletion.next(key); steps--)
+            {
+                Node* buried = locate(tree, key);
+                if(buried == null || !buried->dead_) continue;
+
+                tree = remove_process(tree, key);
+                deletion.purged();
+            }
+
+            return deletion.tombstones();
+        }
+    }
+
+    //Changes the payload of the node in place, the node stays where it is:
+    template <class Func> Node* modify(Node*&, Node* node, Func& change)
+    {
+        change(*node->data_);
+        return node;
+    }
+
+    //Поиск узлов дерева:
+    Node* search(Node* node, int key)
+    {
+        if(node == null) return null;
+        if(node->key() == key) return is_dead(node) ? null : node;
+
+        return (key < node->key()) ? search(node->get_left(), key) : search(node->get_right(), key);
+    }
+
+    Node* getMin(Node* node)
+    {
+        if(node == null) return null;
+        if(node->get_left() == null) return node;
+        return getMin(node->get_left());
+    }
+    Node* getMax(Node* node)
+    {
+        if(node == null) return null;
+        if(node->get_right() == null) return node;
+        return getMax(node->get_right());
+    }
+
+    //Дополнительный функционал дерева:
+    void printTree(Node* node)
+    {
+        if(node == null) return;
+        printTree(node->get_right());
+        printTree(node->get_left());
+        if(is_dead(node)) return;
+        std::cout << "Node's key: " << node->key_ << "  -  Node's value: " << node->data() << "  -  Node's adress: " << node << std::endl;
+    }
+
+    void deleteTree(Node*& node)
+    {
+        if(node == null) return;
+
+        Node* delLeft = node->get_left();
+        Node* delRight = node->get_right();
+
+        deleteTree(delLeft);
+        deleteTree(delRight);
+
+        Node::destroy(node);
+        node = null;
+
+        if constexpr(Deletion::lazy)
+            deletion.clear();
+    }
+
+    void copyTree(Node* node_donor, Node* node_recipient)
+    {
+        if(node_donor == null) return;
+        copyTree(node_donor->get_right(), node_recipient->get_right());
+        copyTree(node_donor->get_left(), node_recipient->get_left());
+        T donor_data = node_donor->data();
+        node_recipient->set_key(node_donor->key());
+        node_recipient->set_data(&donor_data);
+    }
+
+    template <class Func> void traverseTree(Node* node, Func& visit)
+    {
+        if(node == null) return;
+        traverseTree(node->get_left(), visit);
+        if(!is_dead(node)) visit(node);
+        traverseTree(node->get_right(), visit);
+    }
+
+    int getSizeTree(Node* node)
+    {
+        int countNodes = 0;
+        checkSizeTree_process(node, &countNodes);
+
+        if constexpr(Deletion::lazy)
+            countNodes -= int(deletion.tombstones());
+        return countNodes;
+    }
+
+    //The nodes are not walked - they all have the same size; the tombstones are nodes too:
+    MemoryUsage memoryUsage(Node*, size_t nodes)
+    {
+        if constexpr(Deletion::lazy)
+            nodes += deletion.tombstones();
+
+        return MemoryUsage::of<Node, Values, T>(nodes);
+    }
+
+    //The keys grow in the order of the tree, every height is right, no node is out of balance and the tombstones are all counted:
+    bool validate(Node* tree)
+    {
+        if constexpr(Deletion::lazy)
+            if(countTombstones(tree) != deletion.tombstones()) return false;
+
+        return validate_process(tree, INT64_MIN, INT64_MAX) >= -1;
+    }
+
+    //The nodes with keys >= key go to right, which must be empty:
+    void split(Node*& tree, int key, Node*& right)
+    {
+        Node* left;
+        split_process(tree, key, left, right);
+        tree = left;
+    }
+
+    //All keys of right are larger than the keys of the tree; right becomes empty:
+    void join(Node*& tree, Node*& right)
+    {
+        if(right == null) return;
+
+        Node* middle;
+        Node* rest = detachMin(right, middle);
+        tree = join_process(tree, middle, rest);
+        right = null;
+    }
+
+    //Any keys, in linear time: both trees are read in the order of keys and rebuilt as one; on equal keys the node of the tree stays
+    void merge(Node*& tree, Node*& other)
+    {
+        std::vector<Node*> nodes = mergeNodes(tree, other);
+
+        tree = build_process(nodes, 0, int(nodes.size()));
+        other = null;
+    }
+
+    //Nothing is cached about the tree outside of its nodes but the count of them for Deletion::Lazy:
+    void adopt(Node*)
+    {
+        if constexpr(Deletion::lazy)
+            deletion.forget();
+    }
+
+
+private:
+    Deletion deletion;
+
+    bool is_dead(Node* node)
+    {
+        return Deletion::lazy && node->dead_;
+    }
+
+    //search() which also finds the tombstones:
+    Node* locate(Node* node, int key)
+    {
+        while(node != null && node->key() != key)
+            node = (key < node->key()) ? node->get_left() : node->get_right();
+
+        return node;
+    }
+
+    //Called after every insert and remove, does nothing until there are enough tombstones:
+    void purge_due(Node*& tree)
+    {
+        if(!deletion.counted())
+        {
+            int countNodes = 0;
+            checkSizeTree_process(tree, &countNodes);
+            deletion.recount(countNodes);
+        }
+
+        purge(tree, deletion.due());
+    }
+
+    size_t countTombstones(Node* node)
+    {
+        if(node == null) return 0;
+        return countTombstones(node->get_left()) + countTombstones(node->get_right()) + (node->dead_ ? 1 : 0);
+    }
+
+    //The height of the subtree, or -2 if something is broken:
+    int validate_process(Node* node, int64_t low, int64_t high)
+    {
+        if(node == null) return -1;
+        if(node->key() <= low || node->key() >= high) return -2;
+
+        int left = validate_process(node->get_left(), low, node->key());
+        int right = validate_process(node->get_right(), node->key(), high);
+        if(left < -1 || right < -1 || std::abs(left - right) > 1 || calcNodeHeight(node) != std::max(left, right) + 1) return -2;
+
+        return calcNodeHeight(node);
+    }
+
+    //All keys of left < the key of middle < all keys of right:
+    Node* join_process(Node* left, Node* middle, Node* right)
+    {
+        int leftHeight = calcNodeHeight(left);
+        int rightHeight = calcNodeHeight(right);
+
+        if(leftHeight > rightHeight + 1)
+        {
+            left->set_right(join_process(left->get_right(), middle, right));
+            updateHeight(left);
+            balance(left);
+            return left;
+        }
+        if(rightHeight > leftHeight + 1)
+        {
+            right->set_left(join_process(left, middle, right->get_left()));
+            updateHeight(right);
+            balance(right);
+            return right;
+        }
+
+        middle->set_left(left);
+        middle->set_right(right);
+        updateHeight(middle);
+
+        return middle;
+    }
+
+    void split_process(Node* node, int key, Node*& left, Node*& right)
+    {
+        if(node == null)
+        {
+            left = right = null;
+            return;
+        }
+
+        Node* nodeLeft = node->get_left();
+        Node* nodeRight = node->get_right();
+
+        if(key <= node->key())
+        {
+            Node* middle;
+            split_process(nodeLeft, key, left, middle);
+            right = join_process(middle, node, nodeRight);
+        }
+        else
+        {
+            Node* middle;
+            split_process(nodeRight, key, middle, right);
+            left = join_process(nodeLeft, node, middle);
+        }
+    }
+
+    //Takes the node with the smallest key out of the tree without destroying it:
+    Node* detachMin(Node* node, Node*& min)
+    {
+        if(node->get_left() == null)
+        {
+            min = node;
+            return node->get_right();
+        }
+
+        node->set_left(detachMin(node->get_left(), min));
+        updateHeight(node);
+        balance(node);
+
+        return node;
+    }
+
+    std::vector<Node*> mergeNodes(Node* tree, Node* other)
+    {
+        std::vector<Node*> first, second, nodes;
+        auto collectFirst = [&first](Node* node) { first.push_back(node); };
+        auto collectSecond = [&second](Node* node) { second.push_back(node); };
+        traverseTree(tree, collectFirst);
+        traverseTree(other, collectSecond);
+
+        nodes.reserve(first.size() + second.size());
+        size_t i = 0, j = 0;
+        while(i < first.size() || j < second.size())
+        {
+            if(j == second.size() || (i < first.size() && first[i]->key() < second[j]->key()))
+                nodes.push_back(first[i++]);
+            else if(i == first.size() || second[j]->key() < first[i]->key())
+                nodes.push_back(second[j++]);
+            else
+            {
+                nodes.push_back(first[i++]);
+                Node::destroy(second[j++]);
+            }
+        }
+
+        return nodes;
+    }
+
+    Node* build_process(std::vector<Node*>& nodes, int low, int high)
+    {
+        if(low >= high) return null;
+
+        int middle = low + (high - low) / 2;
+        Node* node = nodes[middle];
+        node->set_left(build_process(nodes, low, middle));
+        node->set_right(build_process(nodes, middle + 1, high));
+        updateHeight(node);
+
+        return node;
+    }
+
+    template <class Data> void insert_process(Node* __restrict node, int key, Data* __restrict data)
+    {
+        if(key < node->key())
+        {
+            if(node->get_left() == null) node->set_left(new Node(key, data));
+            else insert_process(node->get_left(), key, data);
+        }
+        else if(key >= node->key())
+        {
+            if(node->get_right() == null) node->set_right(new Node(key, data));
+            else insert_process(node->get_right(), key, data);
+        }
+
+        updateHeight(node);
+        balance(node);
+    }
+
+    Node* remove_process(Node* node, int key)
+    {
+        if(node == null) return null;
+        else if(key < node->key()) node->set_left(remove_process(node->get_left(), key));
+        else if(key > node->key()) node->set_right(remove_process(node->get_right(), key));
+        else
+        {
+            if(node->get_left() == null && node->get_right() == null)
+            {
+                Node::destroy(node);
+                node = null;
+            }
+            else if(node->get_left() == null || node->get_right() == null)
+            {
+                Node* temp = node;
+                node = (node->get_left() == null) ? node->get_right() : node->get_left();
+
+                Node::destroy(temp);
+            }
+            else
+            {
+                Node* maxInLeft = getMax(node->get_left());
+                relocated(maxInLeft->key());
+
+                node->set_key(maxInLeft->key());
+                node->data_.swap(maxInLeft->data_);
+                node->dead_ = maxInLeft->dead_;
+                node->set_left(remove_process(node->get_left(), node->key()));
+            }
+        }
+
+        if(node != null)
+        {
+            updateHeight(node);
+            balance(node);
+        }
+
+        return node;
+    }
+
+    void checkSizeTree_process(Node *node, int *count)
+    {
+        if(node == null) return;
+        checkSizeTree_process(node->get_left(), count);
+        *count += 1;
+        checkSizeTree_process(node->get_right(), count);
+    }
+
+
+    //Дополнительные методы с базовыми математическими операциями:
+    int findMax(int operand_1, int operand_2)
+    {
+        return (operand_1 >= operand_2) ? operand_1 : operand_2;
+    }
+
+    void swap(Node* node_1, Node* node_2)
+    {
+        int node_1_key = node_1->key();
+
+        relocated(node_1_key);
+        relocated(node_2->key());
+
+        node_1->set_key(node_2->key());
+        node_2->set_key(node_1_key);
+
+        node_1->data_.swap(node_2->data_);
+        std::swap(node_1->dead_, node_2->dead_);
+    }
+
+    int calcNodeHeight(Node* node)
+    {
+        return (node == null) ? -1 : node->height_;
+    }
+
+    void updateHeight(Node* node)
+    {
+        node->height_ = findMax(calcNodeHeight(node->get_left()), calcNodeHeight(node->get_right())) + 1;
+    }
+
+    int calcBalanceValue(Node* node)
+    {
+        return (node == null) ? 0 : calcNodeHeight(node->get_right()) - calcNodeHeight(node->get_left());
+    }
+
+
+    void rightRotate(Node* node)
+    {
+        swap(node, node->get_left());
+
+        Node* buffer = node->get_right();
+        node->set_right(node->get_left());
+
+        node->set_left(node->get_right()->get_left());
+
+        node->get_right()->set_left(node->get_right()->get_right());
+        node->get_right()->set_right(buffer);
+
+        updateHeight(node->get_right());
+        updateHeight(node);
+    }
+
+    void leftRotate(Node* node)
+    {
+        swap(node, node->get_right());
+
+        Node* buf_1 = node->get_left();
+        node->set_left(node->get_right());
+
+        node->set_right(node->get_left()->get_right());
+
+        node->get_left()->set_right(node->get_left()->get_left());
+        node->get_left()->set_left(buf_1);
+
+        updateHeight(node->get_left());
+        updateHeight(node);
+    }
+
+    void balance(Node* node)
+    {
+        int balance = calcBalanceValue(node);
+
+        if(balance == -2)
+        {
+            if(calcBalanceValue(node->get_left()) == 1)
+                leftRotate(node->get_left());
+            rightRotate(node);
+        }
+        else if(balance == 2)
+        {
+            if(calcBalanceValue(node->get_right()) == -1)
+                rightRotate(node->get_right());
+            leftRotate(node);
+        }
+    }
+
+};
+template <typename T, class Deletion, class Values> typename BinaryABLTree<T, Deletion, Values>::Node* BinaryABLTree<T, Deletion, Values>::null = nullptr;
+
+template <typename T, class Augment = Augmentation::None, class Deletion = Deletion::Immediate, class Values = Values::Auto<>> class BinaryRedBlackTree: protected RelocationReporter
+{
+protected:
+    class Node: public Augment::Fields
+    {
+        int key_;
+        COLOR color_ = RED;
+        bool dead_ = false; //A tombstone of Deletion::Lazy, which moves together with the key
+        typename Values::template Slot<T> data_;
+
+        Node* left_ = null;
+        Node* right_ = null;
+        Node* parent_ = null;
+
+
+    public:
+        Node() = delete;
+        template <class Data> explicit Node(int key, Data* data, COLOR color = RED): key_(key), color_(color), data_(std::move(*data))
+        {
+
+        }
+
+
+        void update(const T& data)
+        {
+            *data_ = data;
+        }
+
+        T& operator = (const T& data)
+        {
+            *data_ = data;
+            return *data_;
+        }
+
+
+        //Setters:
+        void set_color(COLOR cur_color)
+        {
+            color_ = cur_color;
+        }
+        void set_key(int cur_key)
+        {
+            key_ = cur_key;
+        }
+        void set_data(T* data)
+        {
+            *data_ = *data;
+        }
+        void set_left(Node* cur_left)
+        {
+            left_ = cur_left;
+        }
+        void set_right(Node* cur_right)
+        {
+            right_ = cur_right;
+        }
+        void set_parent(Node* cur_parent)
+        {
+            parent_ = cur_parent;
+        }
+
+        //Getters:
+        int key()
+        {
+            return key_;
+        }
+        const T& data()
+        {
+            return* data_;
+        }
+
+        COLOR color()
+        {
+            return color_;
+        }
+        Node* get_left()
+        {
+            return left_;
+        }
+        Node* get_right()
+        {
+            return right_;
+        }
+        Node* get_parent()
+        {
+            return parent_;
+        }
+
+
+    protected:
+        template <typename U = T>
+        void operator delete(void* ptr, U); //! Либо вместо U использовать - typename std::enable_if<!std::is_same<U, BinarySearchTree>::value>::type* = nullptr - это механизм позволяющий контролировать, что объекту, который захочет удалить Node, разрешено это делать - на самом деле не работает в данном случае, так что это просто как вариант действий
+
+        static void* operator new(size_t)
+        {
+            return Values::template allocateNode<sizeof(Node), alignof(Node)>();
+        }
+        static void operator delete(void* node)
+        {
+            Values::template releaseNode<sizeof(Node), alignof(Node)>(node);
+        }
+
+        static void destroy(Node* node)
+        {
+            node->~Node();
+            operator delete(node);
+        }
+
+        friend class BinaryRedBlackTree;
+    };
+    static Node *null; //Leaves are plain null pointers and are treated as BLACK, so the trees have no shared sentinel to write to
+
+
+    Node *search(Node* node, int key)
+    {
+        if(node == null) return null;
+        if(node->key() == key) return is_dead(node) ? null : node;
+
+        return (key < node->key()) ? search(node->get_left(), key) : search(node->get_right(), key);
+    }
+
+    Node *getMin(Node* node)
+    {
+        if(node == null) return null;
+        if(node->get_left() == null) return node;
+        return getMin(node->get_left());
+    }
+
+    Node *getMax(Node* node)
+    {
+        if(node == null) return null;
+        if(node->get_right() == null) return node;
+        return getMax(node->get_right());
+    }
+
+    //Only for the interval trees: visits the nodes whose intervals [key, data.high] intersect [low, high]
+    template <class Func> void overlaps(Node* node, int low, int high, Func& visit)
+    {
+        if(node == null || node->max_high() < low) return;
+
+        overlaps(node->get_left(), low, high, visit);
+        if(node->key() > high) return;
+
+        if(node->data().high >= low && !is_dead(node)) visit(node);
+        overlaps(node->get_right(), low, high, visit);
+    }
+
+    //The root of the tree is kept by the caller and is updated through the reference:
+    template <class Data> void insert(Node*& node, int key, Data* __restrict data)
+    {
+        if constexpr(Deletion::lazy)
+        {
+            Node* buried = locate(node, key);
+            if(buried != null)
+            {
+                *buried->data_ = BinaryTrees::Values::payload(*data);
+                buried->dead_ = false;
+                updatePath(buried);
+                deletion.revived();
+                purge_due(node);
+                return;
+            }
+            deletion.added();
+        }
+
+        insert_process(node, key, data);
+
+        if constexpr(Deletion::lazy)
+            purge_due(node);
+    }
+
+    //The key is larger than all keys of the tree, so the node is hung under the largest one without a descent:
+    void appendTree(Node*& node, int key, T* __restrict data)
+    {
+        if(maxNode_ == null)
+        {
+            insert(node, key, data);
+            return;
+        }
+
+        Node* newNode = create_node(key, data, RED, maxNode_);
+        maxNode_->set_right(newNode);
+        maxNode_ = newNode;
+
+        updatePath(newNode);
+        balance(node, newNode);
+
+        if constexpr(Deletion::lazy)
+        {
+            deletion.added();
+            purge_due(node);
+        }
+    }
+
+    void remove(Node*& node, int key)
+    {
+        if constexpr(Deletion::lazy)
+        {
+            Node* target = locate(node, key);
+            if(target == null || target->dead_) return;
+
+            target->dead_ = true;
+            deletion.buried(key);
+            purge_due(node);
+        }
+        else
+            remove_process(node, key);
+    }
+
+    //Takes up to steps tombstones out of the tree, returns the number of the ones left (always none without Deletion::Lazy)
+    size_t purge(Node*& tree, size_t steps)
+    {
+        if constexpr(!Deletion::lazy) return 0;
+        else
+        {
+            int key;
+            for(; steps > 0 && deletion.next(key); steps--)
+            {
+                Node* buried = locate(tree, key);
+                if(buried == null || !buried->dead_) continue;
+
+                remove_process(tree, key);
+                deletion.purged();
+            }
+
+            return deletion.tombstones();
+        }
+    }
+
+    //Changes the payload of the node in place; an augmented tree recomputes the path above the node:
+    template <class Func> Node* modify(Node*&, Node* node, Func& change)
+    {
+        change(*node->data_);
+        updatePath(node);
+        return node;
+    }
+
+
+    void printTree(Node* node)
+    {
+        if(node == null) return;
+        printTree(node->get_right());
+        printTree(node->get_left());
+        if(is_dead(node)) return;
+        std::cout << "Node's key: " << node->key() << "  -  Node's color: " << node->color() << "  -  Node's value: " << node->data() << "  -  Node's adress: " << node << std::endl;
+    }
+
+    void deleteTree(Node*& node)
+    {
+        if(node == null) return;
+
+        Node* delLeft = node->get_left();
+        Node* delRight = node->get_right();
+        deleteTree(delLeft);
+        deleteTree(delRight);
+
+        Node::destroy(node);
+        node = null;
+        maxNode_ = null;
+
+        if constexpr(Deletion::lazy)
+            deletion.clear();
+    }
+
+    void copyTree(Node* node_donor, Node* node_recipient)
+    {
+        if(node_donor == null) return;
+        copyTree(node_donor->get_right(), node_recipient->get_right());
+        copyTree(node_donor->get_left(), node_recipient->get_left());
+        T donor_data = node_donor->data();
+        node_recipient->set_key(node_donor->key());
+        node_recipient->set_data(&donor_data);
+    }
+
+    template <class Func> void traverseTree(Node* node, Func& visit)
+    {
+        if(node == null) return;
+        traverseTree(node->get_left(), visit);
+        if(!is_dead(node)) visit(node);
+        traverseTree(node->get_right(), visit);
+    }
+
+    int getSizeTree(Node* node)
+    {
+        int countNodes = 0;
+        checkSizeTree_process(node, &countNodes);
+
+        if constexpr(Deletion::lazy)
+            countNodes -= int(deletion.tombstones());
+        return countNodes;
+    }
+
+    //The nodes are not walked - they all have the same size; the tombstones are nodes too:
+    MemoryUsage memoryUsage(Node*, size_t nodes)
+    {
+        if constexpr(Deletion::lazy)
+            nodes += deletion.tombstones();
+
+        return MemoryUsage::of<Node, Values, T>(nodes);
+    }
+
+    //The keys grow in the order of the tree, the links to the parents are right, the root is black, no red node has a red child,
+    //all paths have the same number of black nodes, the augmented fields are up to date and the tombstones are all counted:
+    bool validate(Node* tree)
+    {
+        if(getColor(tree) != BLACK || (node_exists(tree) && tree->get_parent() != null)) return false;
+        if constexpr(Deletion::lazy)
+            if(countTombstones(tree) != deletion.tombstones()) return false;
+
+        return validate_process(tree, INT64_MIN, INT64_MAX) >= 0 && maxNode_ == getMax(tree);
+    }
+
+    //The nodes with keys >= key go to right, which must be empty:
+    void split(Node*& tree, int key, Node*& right)
+    {
+        Node* left;
+        int leftHeight, rightHeight;
+        tree = detach(tree);
+        split_process(tree, blackHeight(tree), key, left, leftHeight, right, rightHeight);
+        tree = left;
+        maxNode_ = getMax(tree);
+    }
+
+    //All keys of right are larger than the keys of the tree; right becomes empty:
+    void join(Node*& tree, Node*& right)
+    {
+        if(right == null) return;
+
+        Node* middle = getMin(right);
+        unlink(right, middle);
+        int height;
+        tree = join_process(tree, blackHeight(tree), middle, right, blackHeight(right), height);
+        right = null;
+        maxNode_ = getMax(tree);
+    }
+
+    //Any keys, in linear time: both trees are read in the order of keys and rebuilt as one; on equal keys the node of the tree stays
+    void merge(Node*& tree, Node*& other)
+    {
+        std::vector<Node*> nodes = mergeNodes(tree, other);
+
+        int levels = 0;
+        for(size_t count = nodes.size(); count > 0; count >>= 1)
+            levels++;
+
+        tree = build_process(nodes, 0, int(nodes.size()), 0, (levels > 1) ? levels - 1 : -1, null);
+        other = null;
+        maxNode_ = getMax(tree);
+    }
+
+    //The tree was built by another object (split, join): the largest node is found again
+    void adopt(Node* tree)
+    {
+        maxNode_ = getMax(tree);
+
+        if constexpr(Deletion::lazy)
+            deletion.forget();
+    }
+
+
+private:
+    Deletion deletion;
+
+    bool is_dead(Node* node)
+    {
+        return Deletion::lazy && node->dead_;
+    }
+
+    //search() which also finds the tombstones:
+    Node* locate(Node* node, int key)
+    {
+        while(node_exists(node) && node->key() != key)
+            node = (key < node->key()) ? node->get_left() : node->get_right();
+
+        return node;
+    }
+
+    //Called after every insert and remove, does nothing until there are enough tombstones:
+    void purge_due(Node*& tree)
+    {
+        if(!deletion.counted())
+        {
+            int countNodes = 0;
+            checkSizeTree_process(tree, &countNodes);
+            deletion.recount(countNodes);
+        }
+
+        purge(tree, deletion.due());
+    }
+
+    size_t countTombstones(Node* node)
+    {
+        if(!node_exists(node)) return 0;
+        return countTombstones(node->get_left()) + countTombstones(node->get_right()) + (node->dead_ ? 1 : 0);
+    }
+
+    //The black height of the subtree, or -1 if something is broken:
+    int validate_process(Node* node, int64_t low, int64_t high)
+    {
+        if(!node_exists(node)) return 0;
+        if(node->key() <= low || node->key() >= high) return -1;
+
+        if(node_exists(node->get_left()) && node->get_left()->get_parent() != node) return -1;
+        if(node_exists(node->get_right()) && node->get_right()->get_parent() != node) return -1;
+        if(node->color() == RED && (getColor(node->get_left()) == RED || getColor(node->get_right()) == RED)) return -1;
+        if(!Augment::valid(node)) return -1;
+
+        int left = validate_process(node->get_left(), low, node->key());
+        int right = validate_process(node->get_right(), node->key(), high);
+        if(left < 0 || left != right) return -1;
+
+        return left + (node->color() == BLACK ? 1 : 0);
+    }
+
+    Node* maxNode_ = null; //The node with the largest key, rotations never move it to another node
+
+
+    //A subtree taken out of its tree is a correct tree on its own once its root is black:
+    Node* detach(Node* node)
+    {
+        if(node_exists(node))
+        {
+            node->set_parent(null);
+            node->set_color(BLACK);
+        }
+
+        return node;
+    }
+
+    int blackHeight(Node* node)
+    {
+        int height = 0;
+        for(; node_exists(node); node = node->get_left())
+            if(node->color() == BLACK) height++;
+
+        return height;
+    }
+
+    //All keys of left < the key of middle < all keys of right: middle is hung as a red node where the black heights meet;
+    //the black heights of left and right are given and the one of the result is returned in height, so that a split never walks a spine
+    Node* join_process(Node* left, int leftHeight, Node* middle, Node* right, int rightHeight, int& height)
+    {
+        Node* tree = (leftHeight >= rightHeight) ? left : right;
+        Node* parent = null;
+        Node* current = tree;
+
+        if(leftHeight >= rightHeight)
+        {
+            for(int height = leftHeight; height > rightHeight || getColor(current) == RED; current = current->get_right())
+            {
+                if(getColor(current) == BLACK) height--;
+                parent = current;
+            }
+            middle->set_left(current);
+            middle->set_right(right);
+        }
+        else
+        {
+            for(int height = rightHeight; height > leftHeight || getColor(current) == RED; current = current->get_left())
+            {
+                if(getColor(current) == BLACK) height--;
+                parent = current;
+            }
+            middle->set_left(left);
+            middle->set_right(current);
+        }
+
+        if(node_exists(middle->get_left())) middle->get_left()->set_parent(middle);
+        if(node_exists(middle->get_right())) middle->get_right()->set_parent(middle);
+        middle->set_parent(parent);
+        middle->set_color(RED);
+
+        if(parent == null)
+            tree = middle;
+        else if(leftHeight >= rightHeight)
+            parent->set_right(middle);
+        else
+            parent->set_left(middle);
+
+        updatePath(middle);
+        height = std::max(leftHeight, rightHeight) + (balance(tree, middle) ? 1 : 0);
+
+        return tree;
+    }
+
+    //height is the black height of node; a child painted black by detach() gains one level over its black sibling
+    void split_process(Node* node, int height, int key, Node*& left, int& leftHeight, Node*& right, int& rightHeight)
+    {
+        if(node == null)
+        {
+            left = right = null;
+            leftHeight = rightHeight = 0;
+            return;
+        }
+
+        int below = height - (node->color() == BLACK ? 1 : 0);
+        int nodeLeftHeight = below + (getColor(node->get_left()) == RED ? 1 : 0);
+        int nodeRightHeight = below + (getColor(node->get_right()) == RED ? 1 : 0);
+        Node* nodeLeft = detach(node->get_left());
+        Node* nodeRight = detach(node->get_right());
+
+        if(key <= node->key())
+        {
+            Node* middle;
+            int middleHeight;
+            split_process(nodeLeft, nodeLeftHeight, key, left, leftHeight, middle, middleHeight);
+            right = join_process(middle, middleHeight, node, nodeRight, nodeRightHeight, rightHeight);
+        }
+        else
+        {
+            Node* middle;
+            int middleHeight;
+            split_process(nodeRight, nodeRightHeight, key, middle, middleHeight, right, rightHeight);
+            left = join_process(nodeLeft, nodeLeftHeight, node, middle, middleHeight, leftHeight);
+        }
+    }
+
+    std::vector<Node*> mergeNodes(Node* tree, Node* other)
+    {
+        std::vector<Node*> first, second, nodes;
+        auto collectFirst = [&first](Node* node) { first.push_back(node); };
+        auto collectSecond = [&second](Node* node) { second.push_back(node); };
+        traverseTree(tree, collectFirst);
+        traverseTree(other, collectSecond);
+
+        nodes.reserve(first.size() + second.size());
+        size_t i = 0, j = 0;
+        while(i < first.size() || j < second.size())
+        {
+            if(j == second.size() || (i < first.size() && first[i]->key() < second[j]->key()))
+                nodes.push_back(first[i++]);
+            else if(i == first.size() || second[j]->key() < first[i]->key())
+                nodes.push_back(second[j++]);
+            else
+            {
+                nodes.push_back(first[i++]);
+                Node::destroy(second[j++]);
+            }
+        }
+
+        return nodes;
+    }
+
+    //The middles of the ranges make a tree whose leaves are on the last two levels: all black but the last level, which is red
+    Node* build_process(std::vector<Node*>& nodes, int low, int high, int depth, int redDepth, Node* parent)
+    {
+        if(low >= high) return null;
+
+        int middle = low + (high - low) / 2;
+        Node* node = nodes[middle];
+        node->set_parent(parent);
+        node->set_color((depth == redDepth) ? RED : BLACK);
+        node->set_left(build_process(nodes, low, middle, depth + 1, redDepth, node));
+        node->set_right(build_process(nodes, middle + 1, high, depth + 1, redDepth, node));
+        Augment::update(node);
+
+        return node;
+    }
+
+
+    //Returns whether the root had to be painted black, that is whether the black height of the tree grew:
+    bool balance(Node*& tree, Node* newNode)
+    {
+        Node* uncle;
+
+        while(newNode != tree && newNode->get_parent() != tree && getColor(newNode->get_parent()) == RED)
+        {
+            Node* parent = newNode->get_parent();
+            Node* grandParent = parent->get_parent();
+
+            if(parent == grandParent->get_left())
+            {
+                uncle = grandParent->get_right();
+
+                if(getColor(uncle) == RED)
+                {
+                    parent->set_color(BLACK);
+                    uncle->set_color(BLACK);
+                    grandParent->set_color(RED);
+                    newNode = grandParent;
+                }
+                else
+                {
+                    if(newNode == parent->get_right())
+                    {
+                        newNode = parent;
+                        leftRotate(tree, newNode);
+                        parent = newNode->get_parent();
+                    }
+
+                    parent->set_color(BLACK);
+                    grandParent->set_color(RED);
+                    rightRotate(tree, grandParent);
+                }
+            }
+            else
+            {
+                uncle = grandParent->get_left();
+
+                if(getColor(uncle) == RED)
+                {
+                    parent->set_color(BLACK);
+                    uncle->set_color(BLACK);
+                    grandParent->set_color(RED);
+                    newNode = grandParent;
+                }
+                else
+                {
+                    if(newNode == parent->get_left())
+                    {
+                        newNode = parent;
+                        rightRotate(tree, newNode);
+                        parent = newNode->get_parent();
+                    }
+
+                    parent->set_color(BLACK);
+                    grandParent->set_color(RED);
+                    leftRotate(tree, grandParent);
+                }
+            }
+        }
+
+        bool grew = (tree->color() == RED);
+        tree->set_color(BLACK);
+        return grew;
+    }
+
+    template <class Data> void insert_process(Node*& tree, int key, Data* __restrict data)
+    {
+        Node* currentNode = tree;
+        Node* parent = null;
+
+        while(node_exists(currentNode))
+        {
+            parent = currentNode;
+            if(key < currentNode->key())
+                currentNode = currentNode->get_left();
+            else
+                currentNode = currentNode->get_right();
+        }
+
+
+        Node* newNode = create_node(key, data, RED, parent);
+
+        if(parent == null)
+            tree = newNode;
+        else if(key < parent->key())
+            parent->set_left(newNode);
+        else
+            parent->set_right(newNode);
+
+        if(maxNode_ == null || key >= maxNode_->key())
+            maxNode_ = newNode;
+
+        updatePath(newNode);
+        balance(tree, newNode);
+    }
+
+    void balance(Node*& tree, Node* child, Node* parent)
+    {
+        while(child != tree && getColor(child) == BLACK)
+        {
+            Node* brother;
+
+            if(child == parent->get_left())
+            {
+                brother = parent->get_right();
+                if(getColor(brother) == RED)
+                {
+                    brother->set_color(BLACK);
+                    parent->set_color(RED);
+                    leftRotate(tree, parent);
+                    brother = parent->get_right();
+                }
+                if(getColor(brother->get_left()) == BLACK && getColor(brother->get_right()) == BLACK)
+                {
+                    brother->set_color(RED);
+                    child = parent;
+                    parent = child->get_parent();
+                }
+                else
+                {
+                    if(getColor(brother->get_right()) == BLACK)
+                    {
+                        brother->get_left()->set_color(BLACK);
+                        brother->set_color(RED);
+                        rightRotate(tree, brother);
+                        brother = parent->get_right();
+                    }
+
+                    brother->set_color(parent->color());
+                    parent->set_color(BLACK);
+                    brother->get_right()->set_color(BLACK);
+                    leftRotate(tree, parent);
+
+                    child = tree;
+                }
+            }
+            else
+            {
+                brother = parent->get_left();
+                if(getColor(brother) == RED)
+                {
+                    brother->set_color(BLACK);
+                    parent->set_color(RED);
+                    rightRotate(tree, parent);
+                    brother = parent->get_left();
+                }
+                if(getColor(brother->get_left()) == BLACK && getColor(brother->get_right()) == BLACK)
+                {
+                    brother->set_color(RED);
+                    child = parent;
+                    parent = child->get_parent();
+                }
+                else
+                {
+                    if(getColor(brother->get_left()) == BLACK)
+                    {
+                        brother->get_right()->set_color(BLACK);
+                        brother->set_color(RED);
+                        leftRotate(tree, brother);
+                        brother = parent->get_left();
+                    }
+
+                    brother->set_color(parent->color());
+                    parent->set_color(BLACK);
+                    brother->get_left()->set_color(BLACK);
+                    rightRotate(tree, parent);
+
+                    child = tree;
+                }
+            }
+        }
+
+        if(node_exists(child))
+            child->set_color(BLACK);
+    }
+
+    void remove_process(Node*& tree, int key)
+    {
+        Node* nodeToDelete = locate(tree, key);
+        if(!node_exists(nodeToDelete)) return;
+
+        if(getChildrenCount(nodeToDelete) == 2)
+        {
+            Node* minNode = getMin(nodeToDelete->get_right());
+            relocated(minNode->key());
+
+            nodeToDelete->set_key(minNode->key());
+            nodeToDelete->data_.swap(minNode->data_);
+            nodeToDelete->dead_ = minNode->dead_;
+
+            nodeToDelete = minNode;
+        }
+
+        unlink(tree, nodeToDelete);
+
+        if(nodeToDelete == maxNode_)
+            maxNode_ = getMax(tree);
+
+        Node::destroy(nodeToDelete);
+    }
+
+    //Takes a node with at most one child out of the tree without destroying it:
+    void unlink(Node*& tree, Node* node)
+    {
+        Node* parent = node->get_parent();
+        Node* child = getChildOrMock(node);
+        transplainNode(tree, node, child);
+        updatePath(parent);
+
+        if(node->color() == BLACK)
+            balance(tree, child, parent);
+    }
+
+    void checkSizeTree_process(Node* node, int* count)
+    {
+        if(node == null) return;
+        checkSizeTree_process(node->get_left(), count);
+        *count += 1;
+        checkSizeTree_process(node->get_right(), count);
+    }
+
+
+    bool node_exists(Node *node)
+    {
+        return node != null;
+    }
+
+    COLOR getColor(Node *node)
+    {
+        return node_exists(node) ? node->color() : BLACK;
+    }
+
+    template <class Data> Node *create_node(int key, Data* __restrict data, COLOR color, Node* __restrict parent)
+    {
+        Node* newNode = new Node(key, data, color);
+        newNode->set_parent(parent);
+
+        return newNode;
+    }
+
+    int getChildrenCount(Node* node)
+    {
+        int count = 0;
+        if(node_exists(node->get_left()))
+            count += 1;
+        if(node_exists(node->get_right()))
+            count += 1;
+
+        return count;
+    }
+
+    Node* getChildOrMock(Node* node)
+    {
+        return node_exists(node->get_left()) ? node->get_left() : node->get_right();
+    }
+
+    //Recomputes the augmented fields from the node up to the root (nothing to do for the plain tree):
+    void updatePath(Node* node)
+    {
+        if(!Augment::enabled) return;
+
+        for(; node_exists(node); node = node->get_parent())
+            Augment::update(node);
+    }
+
+    void transplainNode(Node*& tree, Node* toNode, Node* fromNode)
+    {
+        if(toNode == tree)
+            tree = fromNode;
+        else if(toNode == toNode->get_parent()->get_left())
+            toNode->get_parent()->set_left(fromNode);
+        else
+            toNode->get_parent()->set_right(fromNode);
+
+
+        if(node_exists(fromNode))
+            fromNode->set_parent(toNode->get_parent());
+    }
+
+    void rightRotate(Node*& tree, Node* node)
+    {
+        Node* left = node->get_left();
+
+        node->set_left(left->get_right());
+        if(node_exists(left->get_right()))
+            left->get_right()->set_parent(node);
+
+        transplainNode(tree, node, left);
+
+        left->set_right(node);
+        node->set_parent(left);
+
+        Augment::update(node);
+        Augment::update(left);
+    }
+
+    void leftRotate(Node*& tree, Node* node)
+    {
+        Node* right = node->get_right();
+
+        node->set_right(right->get_left());
+        if(node_exists(right->get_left()))
+            right->get_left()->set_parent(node);
+
+        transplainNode(tree, node, right);
+
+        right->set_left(node);
+        node->set_parent(right);
+
+        Augment::update(node);
+        Augment::update(right);
+    }
+};
+template <typename T, class Augment, class Deletion, class Values> typename BinaryRedBlackTree<T, Augment, Deletion, Values>::Node* BinaryRedBlackTree<T, Augment, Deletion, Values>::null = nullptr;
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * *  Compact layout of the red-black tree:          * *
+ * *    - nodes live in a pool owned by the tree and * *
+ * *      are linked by 32-bit indices (0 - no node) * *
+ * *    - the color is kept in the low bit of the    * *
+ * *      parent link                                * *
+ * *    - the data is stored in the node itself      * *
+ * *  so a node takes 16 bytes plus sizeof(T).       * *
+ * *  Pointers to the nodes returned by search()     * *
+ * *  stay valid only until the next insert()!       * *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * *
+   * * * * * * * * * * * * * * * * * * * * * * * * * */
+template <typename T> class BinaryCompactRedBlackTree: protected RelocationReporter
+{
+protected:
+    typedef uint32_t Link;
+    static constexpr Link nil = 0;
+
+    class Node
+    {
+        int key_;
+        Link parent_ = nil; //parent's index << 1 | color
+        Link left_ = nil;
+        Link right_ = nil;
+        T data_;
+
+
+    public:
+        Node() = delete;
+        template <class Data> explicit Node(int key, Data* data, COLOR color = RED): key_(key), parent_(color), data_(Values::payload(*data))
+        {
+
+        }
+
+
+        void update(const T& data)
+        {
+            data_ = data;
+        }
+
+        T& operator = (const T& data)
+        {
+            data_ = data;
+            return data_;
+        }
+
+
+        //Setters:
+        void set_key(int cur_key)
+        {
+            key_ = cur_key;
+        }
+        void set_data(T* data)
+        {
+            data_ = *data;
+        }
+
+        //Getters:
+        int key()
+        {
+            return key_;
+        }
+        const T& data()
+        {
+            return data_;
+        }
+        COLOR color()
+        {
+            return parent_ & 1;
+        }
+
+        friend class BinaryCompactRedBlackTree;
+    };
+    static Node *null;
+
+
+    Node *search(Node* node, int key)
+    {
+        Link current = index_of(node);
+        while(current != nil && at(current).key() != key)
+            current = (key < at(current).key()) ? get_left(current) : get_right(current);
+
+        return node_of(current);
+    }
+
+    Node *getMin(Node* node)
+    {
+        return node_of(getMin(index_of(node)));
+    }
+
+    Node *getMax(Node* node)
+    {
+        return node_of(getMax(index_of(node)));
+    }
+
+    template <class Data> void insert(Node*& node, int key, Data* __restrict data)
+    {
+        insert_process(key, data);
+        node = node_of(root_);
+    }
+
+    void appendTree(Node*& node, int key, T* __restrict data)
+    {
+        if(max_ == nil) insert_process(key, data);
+        else
+        {
+            Link newNode = create_node(key, data, max_);
+            set_right(max_, newNode);
+            max_ = newNode;
+
+            balance(newNode);
+        }
+
+        node = node_of(root_);
+    }
+
+    void remove(Node*& node, int key)
+    {
+        remove_process(key);
+        node = node_of(root_);
+    }
+
+    //Changes the payload of the node in place, inside the pool:
+    template <class Func> Node* modify(Node*&, Node* node, Func& change)
+    {
+        change(node->data_);
+        return node;
+    }
+
+
+    void printTree(Node* node)
+    {
+        printTree_process(index_of(node));
+    }
+
+    void deleteTree(Node*& node)
+    {
+        pool_.clear();
+        root_ = nil;
+        max_ = nil;
+        free_ = nil;
+        node = null;
+    }
+
+    template <class Func> void traverseTree(Node* node, Func& visit)
+    {
+        traverseTree_process(index_of(node), visit);
+    }
+
+    int getSizeTree(Node* node)
+    {
+        int countNodes = 0;
+        checkSizeTree_process(index_of(node), &countNodes);
+
+        return countNodes;
+    }
+
+    //One block for all nodes: the free and not yet used slots of the pool are reserved memory
+    MemoryUsage memoryUsage(Node*, size_t nodes)
+    {
+        MemoryUsage usage;
+        usage.nodes = nodes;
+        usage.nodeBytes = nodes * sizeof(Node);
+        usage.reservedBytes = (pool_.capacity() - nodes) * sizeof(Node);
+        return usage;
+    }
+
+    //The rules of the red-black tree on the links of the pool; every slot of the pool is either in the tree or in the free list:
+    bool validate(Node* tree)
+    {
+        if(index_of(tree) != root_ || getColor(root_) != BLACK || (root_ != nil && get_parent(root_) != nil)) return false;
+        if(validate_process(root_, INT64_MIN, INT64_MAX) < 0 || max_ != getMax(root_)) return false;
+
+        size_t slots = size_t(getSizeTree(tree));
+        for(Link node = free_; node != nil && slots <= pool_.size(); node = get_left(node))
+            slots++;
+
+        return slots == pool_.size();
+    }
+
+    /* * * * * * * * * * * * * * * * * * * * * * * * * * *
+     * *  Re-lays the nodes densely in the given order,  * *
+     * *  dropping the removed slots: in-order layout    * *
+     * *  suits range scans, breadth-first layout puts   * *
+     * *  the top levels of the tree next to each other  * *
+       * * * * * * * * * * * * * * * * * * * * * * * * * * */
+    void compact(Node*& node, NodeOrder order)
+    {
+        std::vector<Link> newOrder;
+        newOrder.reserve(pool_.size());
+
+        if(order == NodeOrder::InOrder)
+            inOrder_process(root_, newOrder);
+        else if(root_ != nil)
+        {
+            newOrder.push_back(root_);
+            for(size_t i = 0; i < newOrder.size(); i++)
+            {
+                if(get_left(newOrder[i]) != nil) newOrder.push_back(get_left(newOrder[i]));
+                if(get_right(newOrder[i]) != nil) newOrder.push_back(get_right(newOrder[i]));
+            }
+        }
+
+        std::vector<Link> newIndex(pool_.size() + 1, nil);
+        for(size_t i = 0; i < newOrder.size(); i++)
+            newIndex[newOrder[i]] = Link(i + 1);
+
+        std::vector<Node> relaid;
+        relaid.reserve(newOrder.size());
+        for(Link oldNode : newOrder)
+        {
+            relaid.push_back(std::move(at(oldNode)));
+            relaid.back().left_ = newIndex[relaid.back().left_];
+            relaid.back().right_ = newIndex[relaid.back().right_];
+            relaid.back().parent_ = (newIndex[relaid.back().parent_ >> 1] << 1) | relaid.back().color();
+        }
+
+        pool_.swap(relaid);
+        relocatedAll();
+        root_ = newIndex[root_];
+        max_ = newIndex[max_];
+        free_ = nil;
+        node = node_of(root_);
+    }
+
+    /* * * * * * * * * * * * * * * * * * * * * * * * * * *
+     * *  The nodes hold no pointers, so for trivially   * *
+     * *  copyable data the whole pool is written and    * *
+     * *  read back as one block of memory. load()       * *
+     * *  checks the header, every link and the rules of * *
+     * *  the tree before it adopts the pool, and keeps  * *
+     * *  the old tree if anything is wrong              * *
+       * * * * * * * * * * * * * * * * * * * * * * * * * * */
+    bool save(std::ostream& out)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable data can be saved as raw memory!");
+
+        CheckpointHeader header;
+        header.nodes = Link(pool_.size());
+        header.root = root_;
+        header.free = free_;
+
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(pool_.data()), std::streamsize(pool_.size() * sizeof(Node)));
+
+        return bool(out);
+    }
+
+    bool load(std::istream& in, Node*& node)
+    {
+        static_assert(std::is_trivially_copyable<T>::value && std::is_default_constructible<T>::value, "Only trivially copyable data with a default constructor can be loaded from raw memory!");
+
+        CheckpointHeader expected, header;
+        if(!in.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+        if(header.magic != expected.magic || header.version != expected.version || header.nodeSize != expected.nodeSize) return false;
+        if(header.nodes > maxNodes || header.root > header.nodes || header.free > header.nodes) return false;
+
+        //The pool grows only with the records actually read, so a broken count can not ask for a huge block:
+        std::vector<Node> loaded;
+        T data = T();
+        Node record(0, &data);
+        for(Link i = 0; i < header.nodes; i++)
+        {
+            if(!in.read(reinterpret_cast<char*>(&record), sizeof(Node))) return false;
+            if(record.left_ > header.nodes || record.right_ > header.nodes || (record.parent_ >> 1) > header.nodes) return false;
+
+            loaded.push_back(record);
+        }
+
+        pool_.swap(loaded);
+        Link oldRoot = root_, oldMax = max_, oldFree = free_;
+        root_ = header.root;
+        free_ = header.free;
+        max_ = nil;
+
+        if(!adoptable())
+        {
+            pool_.swap(loaded);
+            root_ = oldRoot;
+            max_ = oldMax;
+            free_ = oldFree;
+            return false;
+        }
+
+        relocatedAll();
+        max_ = getMax(root_);
+        node = node_of(root_);
+
+        return true;
+    }
+
+
+private:
+    static constexpr Link maxNodes = Link(1) << 31; //parent_ keeps the index shifted by one bit
+
+    struct CheckpointHeader
+    {
+        uint32_t magic = 0x31425243; //"CRB1"
+        uint32_t version = 1;
+        uint32_t nodeSize = sizeof(Node);
+        Link nodes = 0;
+        Link root = nil;
+        Link free = nil;
+    };
+
+    //A loaded pool is a red-black tree whose slots are each either in the tree or once in the free list:
+    bool adoptable()
+    {
+        if(getColor(root_) != BLACK || (root_ != nil && get_parent(root_) != nil)) return false;
+        if(validate_process(root_, INT64_MIN, INT64_MAX) < 0) return false;
+
+        std::vector<Link> slots;
+        inOrder_process(root_, slots);
+
+        std::vector<bool> seen(pool_.size() + 1, false);
+        for(Link slot : slots)
+            seen[slot] = true;
+        for(Link slot = free_; slot != nil; slot = get_left(slot))
+        {
+            if(seen[slot]) return false;
+            seen[slot] = true;
+            slots.push_back(slot);
+        }
+
+        return slots.size() == pool_.size();
+    }
+
+    //The black height of the subtree, or -1 if something is broken:
+    int validate_process(Link node, int64_t low, int64_t high)
+    {
+        if(node == nil) return 0;
+        if(node > pool_.size() || at(node).key() <= low || at(node).key() >= high) return -1;
+
+        if(get_left(node) != nil && get_parent(get_left(node)) != node) return -1;
+        if(get_right(node) != nil && get_parent(get_right(node)) != node) return -1;
+        if(getColor(node) == RED && (getColor(get_left(node)) == RED || getColor(get_right(node)) == RED)) return -1;
+
+        int left = validate_process(get_left(node), low, at(node).key());
+        int right = validate_process(get_right(node), at(node).key(), high);
+        if(left < 0 || left != right) return -1;
+
+        return left + (getColor(node) == BLACK ? 1 : 0);
+    }
+
+    std::vector<Node> pool_;
+    Link root_ = nil;
+    Link max_ = nil; //The node with the largest key, append goes right after it
+    Link free_ = nil; //Removed nodes are chained through left_ and reused by the next inserts
+
+
+    //Access to the nodes by their indices:
+    Node& at(Link node)
+    {
+        return pool_[node - 1];
+    }
+
+    Link index_of(Node* node)
+    {
+        return (node == null) ? nil : Link(node - pool_.data()) + 1;
+    }
+
+    Node* node_of(Link node)
+    {
+        return (node == nil) ? null : &at(node);
+    }
+
+    Link get_left(Link node)
+    {
+        return at(node).left_;
+    }
+    Link get_right(Link node)
+    {
+        return at(node).right_;
+    }
+    Link get_parent(Link node)
+    {
+        return at(node).parent_ >> 1;
+    }
+    COLOR getColor(Link node)
+    {
+        return (node == nil) ? BLACK : at(node).color();
+    }
+
+    void set_left(Link node, Link cur_left)
+    {
+        at(node).left_ = cur_left;
+    }
+    void set_right(Link node, Link cur_right)
+    {
+        at(node).right_ = cur_right;
+    }
+    void set_parent(Link node, Link cur_parent)
+    {
+        at(node).parent_ = (cur_parent << 1) | (at(node).parent_ & 1);
+    }
+    void set_color(Link node, COLOR cur_color)
+    {
+        at(node).parent_ = (at(node).parent_ & ~Link(1)) | Link(cur_color);
+    }
+
+    template <class Data> Link create_node(int key, Data* __restrict data, Link parent)
+    {
+        Link newNode;
+
+        if(free_ != nil)
+        {
+            newNode = free_;
+            free_ = get_left(free_);
+            at(newNode) = Node(key, data, RED);
+        }
+        else
+        {
+            if(pool_.size() == pool_.capacity()) relocatedAll(); //The pool is going to be moved
+            pool_.emplace_back(key, data, RED);
+            newNode = Link(pool_.size());
+        }
+
+        set_parent(newNode, parent);
+        return newNode;
+    }
+
+    void destroy_node(Link node)
+    {
+        at(node).parent_ = nil;
+        at(node).right_ = nil;
+        at(node).left_ = free_;
+        free_ = node;
+    }
+
+
+    Link getMin(Link node)
+    {
+        if(node == nil) return nil;
+        while(get_left(node) != nil) node = get_left(node);
+        return node;
+    }
+
+    Link getMax(Link node)
+    {
+        if(node == nil) return nil;
+        while(get_right(node) != nil) node = get_right(node);
+        return node;
+    }
+
+    void printTree_process(Link node)
+    {
+        if(node == nil) return;
+        printTree_process(get_right(node));
+        printTree_process(get_left(node));
+        std::cout << "Node's key: " << at(node).key() << "  -  Node's color: " << at(node).color() << "  -  Node's value: " << at(node).data() << "  -  Node's index: " << node << std::endl;
+    }
+
+    void checkSizeTree_process(Link node, int* count)
+    {
+        if(node == nil) return;
+        checkSizeTree_process(get_left(node), count);
+        *count += 1;
+        checkSizeTree_process(get_right(node), count);
+    }
+
+    template <class Func> void traverseTree_process(Link node, Func& visit)
+    {
+        if(node == nil) return;
+        traverseTree_process(get_left(node), visit);
+        visit(&at(node));
+        traverseTree_process(get_right(node), visit);
+    }
+
+    void inOrder_process(Link node, std::vector<Link>& nodes)
+    {
+        if(node == nil) return;
+        inOrder_process(get_left(node), nodes);
+        nodes.push_back(node);
+        inOrder_process(get_right(node), nodes);
+    }
+
+
+    //The same balancing as in BinaryRedBlackTree, but over the indices:
+    template <class Data> void insert_process(int key, Data* __restrict data)
+    {
+        Link currentNode = root_;
+        Link parent = nil;
+
+        while(currentNode != nil)
+        {
+            parent = currentNode;
+            if(key < at(currentNode).key())
+                currentNode = get_left(currentNode);
+            else
+                currentNode = get_right(currentNode);
+        }
+
+
+        Link newNode = create_node(key, data, parent);
+
+        if(parent == nil)
+            root_ = newNode;
+        else if(key < at(parent).key())
+            set_left(parent, newNode);
+        else
+            set_right(parent, newNode);
+
+        if(max_ == nil || key >= at(max_).key())
+            max_ = newNode;
+
+        balance(newNode);
+    }
+
+    void balance(Link newNode)
+    {
+        while(newNode != root_ && get_parent(newNode) != root_ && getColor(get_parent(newNode)) == RED)
+        {
+            Link parent = get_parent(newNode);
+            Link grandParent = get_parent(parent);
+            bool parentIsLeft = (parent == get_left(grandParent));
+            Link uncle = parentIsLeft ? get_right(grandParent) : get_left(grandParent);
+
+            if(getColor(uncle) == RED)
+            {
+                set_color(parent, BLACK);
+                set_color(uncle, BLACK);
+                set_color(grandParent, RED);
+                newNode = grandParent;
+            }
+            else
+            {
+                if(parentIsLeft && newNode == get_right(parent))
+                {
+                    newNode = parent;
+                    leftRotate(newNode);
+                    parent = get_parent(newNode);
+                }
+                else if(!parentIsLeft && newNode == get_left(parent))
+                {
+                    newNode = parent;
+                    rightRotate(newNode);
+                    parent = get_parent(newNode);
+                }
+
+                set_color(parent, BLACK);
+                set_color(grandParent, RED);
+                if(parentIsLeft) rightRotate(grandParent);
+                else leftRotate(grandParent);
+            }
+        }
+
+        set_color(root_, BLACK);
+    }
+
+    void remove_process(int key)
+    {
+        Link nodeToDelete = index_of(search(node_of(root_), key));
+        if(nodeToDelete == nil) return;
+
+        if(get_left(nodeToDelete) != nil && get_right(nodeToDelete) != nil)
+        {
+            Link minNode = getMin(get_right(nodeToDelete));
+            relocated(at(minNode).key());
+
+            at(nodeToDelete).set_key(at(minNode).key());
+            std::swap(at(nodeToDelete).data_, at(minNode).data_);
+
+            nodeToDelete = minNode;
+        }
+
+        Link parent = get_parent(nodeToDelete);
+        Link child = (get_left(nodeToDelete) != nil) ? get_left(nodeToDelete) : get_right(nodeToDelete);
+        transplainNode(nodeToDelete, child);
+
+        if(getColor(nodeToDelete) == BLACK)
+            balance(child, parent);
+
+        if(nodeToDelete == max_)
+            max_ = getMax(root_);
+
+        destroy_node(nodeToDelete);
+    }
+
+    void balance(Link child, Link parent)
+    {
+        while(child != root_ && getColor(child) == BLACK)
+        {
+            bool childIsLeft = (child == get_left(parent));
+            Link brother = childIsLeft ? get_right(parent) : get_left(parent);
+
+            if(getColor(brother) == RED)
+            {
+                set_color(brother, BLACK);
+                set_color(parent, RED);
+                if(childIsLeft) leftRotate(parent);
+                else rightRotate(parent);
+                brother = childIsLeft ? get_right(parent) : get_left(parent);
+            }
+
+            Link nearNephew = childIsLeft ? get_left(brother) : get_right(brother);
+            Link farNephew = childIsLeft ? get_right(brother) : get_left(brother);
+
+            if(getColor(nearNephew) == BLACK && getColor(farNephew) == BLACK)
+            {
+                set_color(brother, RED);
+                child = parent;
+                parent = get_parent(child);
+            }
+            else
+            {
+                if(getColor(farNephew) == BLACK)
+                {
+                    set_color(nearNephew, BLACK);
+                    set_color(brother, RED);
+                    if(childIsLeft) rightRotate(brother);
+                    else leftRotate(brother);
+                    brother = childIsLeft ? get_right(parent) : get_left(parent);
+                    farNephew = childIsLeft ? get_right(brother) : get_left(brother);
+                }
+
+                set_color(brother, getColor(parent));
+                set_color(parent, BLACK);
+                set_color(farNephew, BLACK);
+                if(childIsLeft) leftRotate(parent);
+                else rightRotate(parent);
+
+                child = root_;
+            }
+        }
+
+        if(child != nil)
+            set_color(child, BLACK);
+    }
+
+    void transplainNode(Link toNode, Link fromNode)
+    {
+        Link parent = get_parent(toNode);
+
+        if(toNode == root_)
+            root_ = fromNode;
+        else if(toNode == get_left(parent))
+            set_left(parent, fromNode);
+        else
+            set_right(parent, fromNode);
+
+
+        if(fromNode != nil)
+            set_parent(fromNode, parent);
+    }
+
+    void rightRotate(Link node)
+    {
+        Link left = get_left(node);
+
+        set_left(node, get_right(left));
+        if(get_right(left) != nil)
+            set_parent(get_right(left), node);
+
+        transplainNode(node, left);
+
+        set_right(left, node);
+        set_parent(node, left);
+    }
+
+    void leftRotate(Link node)
+    {
+        Link right = get_right(node);
+
+        set_right(node, get_left(right));
+        if(get_left(right) != nil)
+            set_parent(get_left(right), node);
+
+        transplainNode(node, right);
+
+        set_left(right, node);
+        set_parent(node, right);
+    }
+};
+template <typename T> typename BinaryCompactRedBlackTree<T>::Node* BinaryCompactRedBlackTree<T>::null = nullptr;
+
+/* * * * * * * * * * * * * * * * * * * * * * * * *
+ * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * *  Persistent (path-copying) AVL tree:          * *
+ * *    - nodes are never changed after they are   * *
+ * *      published, every update copies only the  * *
+ * *      O(log n) nodes on the path to the key    * *
+ * *    - nodes are shared between versions and    * *
+ * *      reference-counted, so snapshot() is O(1) * *
+ * *      and a snapshot can be read without locks * *
+ * *      while writers keep mutating the tree     * *
+ * *    - with Reclamation::Epochs the old nodes   * *
+ * *      are retired instead of freed, so read()  * *
+ * *      walks the latest version without locks   * *
+ * *      and without touching the references      * *
+ * * * * * * * * * * * * * * * * * * * * * * * * * *
+   * * * * * * * * * * * * * * * * * * * * * * * * */
+template <typename T, class Reclaim = Reclamation::Immediate> class BinaryPersistentTree: protected RelocationReporter
+{
+protected:
+    class Node
+    {
+        int key_;
+        T data_;
+        int height_ = 0;
+        mutable std::atomic<int> refs_{1};
+
+        Node* left_ = null;
+        Node* right_ = null;
+
+    public:
+        Node() = delete;
+        template <class Data> explicit Node(int key, Data* data): key_(key), data_(Values::payload(*data))
+        {
+
+        }
+        explicit Node(const Node* proto, Node* left, Node* right): key_(proto->key_), data_(proto->data_), left_(left), right_(right)
+        {
+
+        }
+
+        //Getters:
+        int key() const
+        {
+            return key_;
+        }
+        const T& data() const
+        {
+            return data_;
+        }
+        Node* get_left() const
+        {
+            return left_;
+        }
+        Node* get_right() const
+        {
+            return right_;
+        }
+
+        friend class BinaryPersistentTree;
+    };
+    static Node *null;
+
+
+public:
+    /* * * * * * * * * * * * * * * * * * * * * * * *
+     * *  Point-in-time view of the tree: holds a  * *
+     * *  reference to the root of one version, so * *
+     * *  the nodes it sees are never destroyed or * *
+     * *  modified while the snapshot is alive     * *
+       * * * * * * * * * * * * * * * * * * * * * * */
+    //With Reclamation::Epochs a snapshot must not outlive its tree, the nodes are retired into the tree:
+    class Snapshot
+    {
+        Node* root_ = null;
+        Reclaim* reclaim_ = nullptr;
+
+    public:
+        Snapshot() = default;
+        explicit Snapshot(const BinaryPersistentTree& owner, Node* root): root_(acquire(root)), reclaim_(&owner.reclaim_)
+        {
+
+        }
+        Snapshot(const Snapshot& other): root_(acquire(other.root_)), reclaim_(other.reclaim_)
+        {
+
+        }
+        Snapshot(Snapshot&& other) noexcept: root_(other.root_), reclaim_(other.reclaim_)
+        {
+            other.root_ = null;
+        }
+        Snapshot& operator = (Snapshot other) noexcept
+        {
+            std::swap(root_, other.root_);
+            std::swap(reclaim_, other.reclaim_);
+            return *this;
+        }
+        ~Snapshot()
+        {
+            release(root_, reclaim_);
+        }
+
+        const Node* search(int key) const
+        {
+            const Node* node = root_;
+            while(node != null && node->key() != key)
+                node = (key < node->key()) ? node->get_left() : node->get_right();
+
+            return node;
+        }
+
+        int size() const
+        {
+            int countNodes = 0;
+            checkSizeTree_process(root_, &countNodes);
+
+            return countNodes;
+        }
+
+        void printTree() const
+        {
+            printTree_process(root_);
+        }
+    };
+
+    /* * * * * * * * * * * * * * * * * * * * * * * *
+     * *  Lock-free view of the latest version: it  * *
+     * *  pins an epoch instead of a reference, so  * *
+     * *  opening it costs no atomic on the nodes   * *
+     * *  and a long scan never blocks the writers  * *
+       * * * * * * * * * * * * * * * * * * * * * * */
+    class Reader
+    {
+        static_assert(Reclaim::deferred, "Reader needs a deferred reclamation, e.g. Reclamation::Epochs");
+
+        Reclaim* reclaim_ = nullptr;
+        size_t slot_ = 0;
+        const Node* root_ = null;
+
+    public:
+        explicit Reader(const BinaryPersistentTree& owner): reclaim_(&owner.reclaim_), slot_(reclaim_->enter()), root_(owner.published_.load())
+        {
+
+        }
+        Reader(Reader&& other) noexcept: reclaim_(other.reclaim_), slot_(other.slot_), root_(other.root_)
+        {
+            other.reclaim_ = nullptr;
+        }
+        Reader(const Reader&) = delete;
+        Reader& operator = (const Reader&) = delete;
+        Reader& operator = (Reader&&) = delete;
+        ~Reader()
+        {
+            if(reclaim_ != nullptr)
+                reclaim_->leave(slot_);
+        }
+
+        const Node* search(int key) const
+        {
+            const Node* node = root_;
+            while(node != null && node->key() != key)
+                node = (key < node->key()) ? node->get_left() : node->get_right();
+
+            return node;
+        }
+
+        int size() const
+        {
+            int countNodes = 0;
+            checkSizeTree_process(root_, &countNodes);
+
+            return countNodes;
+        }
+
+        //In-order walk, visit(key, data):
+        template <class Func> void forEach(Func visit) const
+        {
+            forEach_process(root_, visit);
+        }
+
+        void printTree() const
+        {
+            printTree_process(root_);
+        }
+    };
+
+
+protected:
+    Node* search(Node* node, int key)
+    {
+        while(node != null && node->key() != key)
+            node = (key < node->key()) ? node->get_left() : node->get_right();
+
+        return node;
+    }
+
+    Node* getMin(Node* node)
+    {
+        if(node == null) return null;
+        while(node->get_left() != null) node = node->get_left();
+        return node;
+    }
+
+    Node* getMax(Node* node)
+    {
+        if(node == null) return null;
+        while(node->get_right() != null) node = node->get_right();
+        return node;
+    }
+
+    template <class Data> void insert(Node*& node, int key, Data* data)
+    {
+        replace_root(node, insert_process(node, key, data));
+    }
+
+    //Path copying needs the whole path anyway:
+    void appendTree(Node*& node, int key, T* data)
+    {
+        insert(node, key, data);
+    }
+
+    void remove(Node*& node, int key)
+    {
+        if(search(node, key) == null) return;
+
+        replace_root(node, remove_process(node, key));
+    }
+
+    //The nodes are shared with the snapshots, so the path to the node is copied and the copy is changed:
+    template <class Func> Node* modify(Node*& tree, Node* node, Func& change)
+    {
+        Node* changed = null;
+        replace_root(tree, modify_process(tree, node->key(), change, changed));
+
+        return changed;
+    }
+
+    void printTree(Node* node)
+    {
+        printTree_process(node);
+    }
+
+    void deleteTree(Node*& node)
+    {
+        replace_root(node, null);
+    }
+
+    template <class Func> void traverseTree(Node* node, Func& visit)
+    {
+        if(node == null) return;
+        traverseTree(node->get_left(), visit);
+        visit(node);
+        traverseTree(node->get_right(), visit);
+    }
+
+    int getSizeTree(Node* node)
+    {
+        int countNodes = 0;
+        checkSizeTree_process(node, &countNodes);
+
+        return countNodes;
+    }
+
+    //Only the current version: the nodes which are held by snapshots alone or wait for reclamation are not counted
+    MemoryUsage memoryUsage(Node*, size_t nodes)
+    {
+        return MemoryUsage::of<Node, Values::Inline, T>(nodes);
+    }
+
+    //The keys grow in the order of the tree, every height is right, no node is out of balance and every node is referenced:
+    bool validate(Node* tree)
+    {
+        return validate_process(tree, INT64_MIN, INT64_MAX) >= -1;
+    }
+
+
+private:
+    //The height of the subtree, or -2 if something is broken:
+    static int validate_process(const Node* node, int64_t low, int64_t high)
+    {
+        if(node == null) return -1;
+        if(node->key() <= low || node->key() >= high || node->refs_.load(std::memory_order_relaxed) < 1) return -2;
+
+        int left = validate_process(node->get_left(), low, node->key());
+        int right = validate_process(node->get_right(), node->key(), high);
+        if(left < -1 || right < -1 || std::abs(left - right) > 1 || node->height_ != std::max(left, right) + 1) return -2;
+
+        return node->height_;
+    }
+
+    //Reference counting of the shared nodes:
+    static Node* acquire(Node* node)
+    {
+        if(node != null)
+            node->refs_.fetch_add(1, std::memory_order_relaxed);
+        return node;
+    }
+
+    //The last reference is gone: the children lose theirs at once, but the node itself may still be read by a Reader:
+    static void release(Node* node, Reclaim* reclaim)
+    {
+        if(node == null) return;
+        if(node->refs_.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+
+        release(node->left_, reclaim);
+        release(node->right_, reclaim);
+        if constexpr(Reclaim::deferred)
+            reclaim->retire(node);
+        else
+            Reclaim::retire(node);
+    }
+
+    void release(Node* node)
+    {
+        release(node, &reclaim_);
+    }
+
+    //The new version is published to the readers before the old one is given up:
+    void replace_root(Node*& root, Node* newRoot)
+    {
+        Node* oldRoot = root;
+        root = newRoot;
+        published_.store(newRoot);
+        release(oldRoot);
+    }
+
+    template <class Func> static void forEach_process(const Node* node, Func& visit)
+    {
+        if(node == null) return;
+        forEach_process(node->get_left(), visit);
+        visit(node->key(), node->data());
+        forEach_process(node->get_right(), visit);
+    }
+
+    //Every function below borrows its arguments and returns an owned reference:
+    template <class Data> Node* insert_process(Node* node, int key, Data* data)
+    {
+        if(node == null) return new Node(key, data);
+
+        Node* child = insert_process((key < node->key()) ? node->get_left() : node->get_right(), key, data);
+        Node* result = (key < node->key()) ? balance(node, child, node->get_right()) : balance(node, node->get_left(), child);
+        release(child);
+
+        return result;
+    }
+
+    Node* remove_process(Node* node, int key)
+    {
+        if(key < node->key())
+        {
+            Node* child = remove_process(node->get_left(), key);
+            Node* result = balance(node, child, node->get_right());
+            release(child);
+            return result;
+        }
+        if(key > node->key())
+        {
+            Node* child = remove_process(node->get_right(), key);
+            Node* result = balance(node, node->get_left(), child);
+            release(child);
+            return result;
+        }
+
+        if(node->get_left() == null) return acquire(node->get_right());
+        if(node->get_right() == null) return acquire(node->get_left());
+
+        Node* maxInLeft = getMax(node->get_left());
+        Node* child = remove_process(node->get_left(), maxInLeft->key());
+        Node* result = balance(maxInLeft, child, node->get_right());
+        release(child);
+
+        return result;
+    }
+
+    template <class Func> Node* modify_process(Node* node, int key, Func& change, Node*& changed)
+    {
+        if(key == node->key())
+        {
+            changed = make_node(node, node->get_left(), node->get_right());
+            change(changed->data_);
+            return changed;
+        }
+
+        Node* child = modify_process((key < node->key()) ? node->get_left() : node->get_right(), key, change, changed);
+        Node* result = (key < node->key()) ? make_node(node, child, node->get_right()) : make_node(node, node->get_left(), child);
+        release(child);
+
+        return result;
+    }
+
+    static void checkSizeTree_process(const Node* node, int* count)
+    {
+        if(node == null) return;
+        checkSizeTree_process(node->get_left(), count);
+        *count += 1;
+        checkSizeTree_process(node->get_right(), count);
+    }
+
+    static void printTree_process(const Node* node)
+    {
+        if(node == null) return;
+        printTree_process(node->get_right());
+        printTree_process(node->get_left());
+        std::cout << "Node's key: " << node->key() << "  -  Node's value: " << node->data() << "  -  Node's adress: " << node << "  -  References: " << node->refs_.load() << std::endl;
+    }
+
+
+    //Balancing by the rules of BinaryABLTree, but by building new nodes instead of rotating in place:
+    static int calcNodeHeight(const Node* node)
+    {
+        return (node == null) ? -1 : node->height_;
+    }
+
+    //The copied node replaces the proto in the new version of the tree:
+    Node* make_node(const Node* proto, Node* left, Node* right)
+    {
+        relocated(proto->key());
+
+        Node* node = new Node(proto, acquire(left), acquire(right));
+        node->height_ = std::max(calcNodeHeight(left), calcNodeHeight(right)) + 1;
+
+        return node;
+    }
+
+    Node* balance(const Node* proto, Node* left, Node* right)
+    {
+        int balance = calcNodeHeight(right) - calcNodeHeight(left);
+
+        if(balance < -1)
+        {
+            if(calcNodeHeight(left->get_left()) >= calcNodeHeight(left->get_right()))
+                return rightRotate(left, make_node(proto, left->get_right(), right));
+
+            Node* middle = left->get_right();
+            Node* newLeft = make_node(left, left->get_left(), middle->get_left());
+            Node* newRight = make_node(proto, middle->get_right(), right);
+            Node* result = make_node(middle, newLeft, newRight);
+            release(newLeft);
+            release(newRight);
+
+            return result;
+        }
+        if(balance > 1)
+        {
+            if(calcNodeHeight(right->get_right()) >= calcNodeHeight(right->get_left()))
+                return leftRotate(right, make_node(proto, left, right->get_left()));
+
+            Node* middle = right->get_left();
+            Node* newLeft = make_node(proto, left, middle->get_left());
+            Node* newRight = make_node(right, middle->get_right(), right->get_right());
+            Node* result = make_node(middle, newLeft, newRight);
+            release(newLeft);
+            release(newRight);
+
+            return result;
+        }
+
+        return make_node(proto, left, right);
+    }
+
+    Node* rightRotate(Node* left, Node* newRight)
+    {
+        Node* result = make_node(left, left->get_left(), newRight);
+        release(newRight);
+        return result;
+    }
+
+    Node* leftRotate(Node* right, Node* newLeft)
+    {
+        Node* result = make_node(right, newLeft, right->get_right());
+        release(newLeft);
+        return result;
+    }
+
+    //The root of the latest version, for the readers which hold no lock:
+    std::atomic<Node*> published_{null};
+    mutable Reclaim reclaim_;
+};
+template <typename T, class Reclaim> typename BinaryPersistentTree<T, Reclaim>::Node* BinaryPersistentTree<T, Reclaim>::null = nullptr;
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * *  Self-adjusting (splay) tree:                       * *
+ * *    - every found, inserted or appended node is      * *
+ * *      lifted to the root, so the hot keys of skewed  * *
+ * *      workloads are found in a few steps             * *
+ * *    - SplayDepth limits the restructuring: search()  * *
+ * *      lifts only the nodes found deeper than it, so  * *
+ * *      lookups of the keys already near the root do   * *
+ * *      not write to the tree at all                   * *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+   * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+template <typename T, int SplayDepth = 0, class Values = Values::Auto<>> class BinarySplayTree: protected RelocationReporter
+{
+protected:
+    class Node
+    {
+        int key_;
+        typename Values::template Slot<T> data_;
+
+        Node* left_ = null;
+        Node* right_ = null;
+        Node* parent_ = null;
+
+    public:
+        Node() = delete;
+        template <class Data> explicit Node(int key, Data* data): key_(key), data_(std::move(*data))
+        {
+
+        }
+
+
+        void update(const T& data)
+        {
+            *data_ = data;
+        }
+
+        T& operator = (const T& data)
+        {
+            *data_ = data;
+            return *data_;
+        }
+
+
+        //Setters:
+        void set_key(int cur_key)
+        {
+            key_ = cur_key;
+        }
+        void set_data(T* data)
+        {
+            *data_ = *data;
+        }
+        void set_left(Node* cur_left)
+        {
+            left_ = cur_left;
+        }
+        void set_right(Node* cur_right)
+        {
+            right_ = cur_right;
+        }
+        void set_parent(Node* cur_parent)
+        {
+            parent_ = cur_parent;
+        }
+
+        //Getters:
+        int key()
+        {
+            return key_;
+        }
+        const T& data()
+        {
+            return* data_;
+        }
+        Node* get_left()
+        {
+            return left_;
+        }
+        Node* get_right()
+        {
+            return right_;
+        }
+        Node* get_parent()
+        {
+            return parent_;
+        }
+
+
+    protected:
+        static void* operator new(size_t)
+        {
+            return Values::template allocateNode<sizeof(Node), alignof(Node)>();
+        }
+        static void operator delete(void* node)
+        {
+            Values::template releaseNode<sizeof(Node), alignof(Node)>(node);
+        }
+
+        static void destroy(Node* node)
+        {
+            delete node;
+        }
+
+        friend class BinarySplayTree;
+    };
+    static Node *null;
+
+
+    //The root changes on every access, so it is updated through the reference:
+    Node* search(Node*& node, int key)
+    {
+        Node* current = node;
+        Node* last = null;
+        int depth = 0;
+
+        while(current != null && current->key() != key)
+        {
+            last = current;
+            current = (key < current->key()) ? current->get_left() : current->get_right();
+            depth++;
+        }
+
+        if(depth > SplayDepth)
+            splay(node, (current != null) ? current : last);
+
+        return current;
+    }
+
+    Node* getMin(Node* node)
+    {
+        if(node == null) return null;
+        while(node->get_left() != null) node = node->get_left();
+        return node;
+    }
+
+    Node* getMax(Node* node)
+    {
+        if(node == null) return null;
+        while(node->get_right() != null) node = node->get_right();
+        return node;
+    }
+
+    template <class Data> void insert(Node*& node, int key, Data* __restrict data)
+    {
+        Node* currentNode = node;
+        Node* parent = null;
+
+        while(currentNode != null)
+        {
+            parent = currentNode;
+            currentNode = (key < currentNode->key()) ? currentNode->get_left() : currentNode->get_right();
+        }
+
+        Node* newNode = new Node(key, data);
+        newNode->set_parent(parent);
+
+        if(parent == null)
+            node = newNode;
+        else if(key < parent->key())
+            parent->set_left(newNode);
+        else
+            parent->set_right(newNode);
+
+        if(maxNode_ == null || key >= maxNode_->key())
+            maxNode_ = newNode;
+
+        splay(node, newNode);
+    }
+
+    //The key is larger than all keys of the tree: after the previous append the largest node is the root or right next to it
+    void appendTree(Node*& node, int key, T* __restrict data)
+    {
+        if(maxNode_ == null)
+        {
+            insert(node, key, data);
+            return;
+        }
+
+        Node* newNode = new Node(key, data);
+        newNode->set_parent(maxNode_);
+        maxNode_->set_right(newNode);
+        maxNode_ = newNode;
+
+        splay(node, newNode);
+    }
+
+    void remove(Node*& node, int key)
+    {
+        Node* nodeToDelete = node;
+        while(nodeToDelete != null && nodeToDelete->key() != key)
+            nodeToDelete = (key < nodeToDelete->key()) ? nodeToDelete->get_left() : nodeToDelete->get_right();
+
+        if(nodeToDelete == null) return;
+        splay(node, nodeToDelete);
+
+        Node* left = nodeToDelete->get_left();
+        Node* right = nodeToDelete->get_right();
+        if(left != null) left->set_parent(null);
+        if(right != null) right->set_parent(null);
+
+        if(left == null)
+            node = right;
+        else
+        {
+            splay(left, getMax(left));
+            left->set_right(right);
+            if(right != null) right->set_parent(left);
+            node = left;
+        }
+
+        if(nodeToDelete == maxNode_)
+            maxNode_ = getMax(node);
+
+        Node::destroy(nodeToDelete);
+    }
+
+    //Changes the payload of the node in place, the node stays where it is:
+    template <class Func> Node* modify(Node*&, Node* node, Func& change)
+    {
+        change(*node->data_);
+        return node;
+    }
+
+    void printTree(Node* node)
+    {
+        auto print = [](Node* current) { std::cout << "Node's key: " << current->key() << "  -  Node's value: " << current->data() << "  -  Node's adress: " << current << std::endl; };
+        traverseTree(node, print);
+    }
+
+    //Splaying may leave long paths, so the tree is unrolled by rotations instead of the recursion:
+    void deleteTree(Node*& node)
+    {
+        while(node != null)
+        {
+            if(node->get_left() != null)
+            {
+                Node* left = node->get_left();
+                node->set_left(left->get_right());
+                left->set_right(node);
+                node = left;
+            }
+            else
+            {
+                Node* right = node->get_right();
+                Node::destroy(node);
+                node = right;
+            }
+        }
+
+        maxNode_ = null;
+    }
+
+    template <class Func> void traverseTree(Node* node, Func& visit)
+    {
+        if(node == null) return;
+
+        Node* end = node->get_parent();
+        for(Node* current = getMin(node); current != end; current = next(current, end))
+            visit(current);
+    }
+
+    int getSizeTree(Node* node)
+    {
+        int countNodes = 0;
+        auto count = [&countNodes](Node*) { countNodes += 1; };
+        traverseTree(node, count);
+
+        return countNodes;
+    }
+
+    //The nodes are not walked - they all have the same size:
+    MemoryUsage memoryUsage(Node*, size_t nodes)
+    {
+        return MemoryUsage::of<Node, Values, T>(nodes);
+    }
+
+    //The keys grow in the order of the tree, the links to the parents are right and the largest node is the remembered one:
+    bool validate(Node* tree)
+    {
+        if(tree != null && tree->get_parent() != null) return false;
+
+        std::vector<Node*> path;
+        Node* node = tree;
+        Node* previous = null;
+
+        while(node != null || !path.empty())
+        {
+            for(; node != null; node = node->get_left())
+                path.push_back(node);
+
+            node = path.back();
+            path.pop_back();
+            if(previous != null && previous->key() >= node->key()) return false;
+            if(node->get_left() != null && node->get_left()->get_parent() != node) return false;
+            if(node->get_right() != null && node->get_right()->get_parent() != node) return false;
+
+            previous = node;
+            node = node->get_right();
+        }
+
+        return maxNode_ == previous;
+    }
+
+
+private:
+    Node* maxNode_ = null; //The node with the largest key, rotations never move it to another node
+
+
+    //The next node in the order of keys, or end after the last node of the subtree:
+    Node* next(Node* node, Node* end)
+    {
+        if(node->get_right() != null) return getMin(node->get_right());
+
+        while(node->get_parent() != end && node == node->get_parent()->get_right())
+            node = node->get_parent();
+
+        return node->get_parent();
+    }
+
+    void splay(Node*& tree, Node* node)
+    {
+        while(node->get_parent() != null)
+        {
+            Node* parent = node->get_parent();
+            Node* grandParent = parent->get_parent();
+
+            if(grandParent == null)
+                rotate(tree, node);
+            else if((node == parent->get_left()) == (parent == grandParent->get_left()))
+            {
+                rotate(tree, parent);
+                rotate(tree, node);
+            }
+            else
+            {
+                rotate(tree, node);
+                rotate(tree, node);
+            }
+        }
+    }
+
+    //Lifts the node above its parent:
+    void rotate(Node*& tree, Node* node)
+    {
+        Node* parent = node->get_parent();
+        Node* grandParent = parent->get_parent();
+
+        if(node == parent->get_left())
+        {
+            parent->set_left(node->get_right());
+            if(node->get_right() != null) node->get_right()->set_parent(parent);
+            node->set_right(parent);
+        }
+        else
+        {
+            parent->set_right(node->get_left());
+            if(node->get_left() != null) node->get_left()->set_parent(parent);
+            node->set_left(parent);
+        }
+
+        parent->set_parent(node);
+        node->set_parent(grandParent);
+
+        if(grandParent == null)
+            tree = node;
+        else if(grandParent->get_left() == parent)
+            grandParent->set_left(node);
+        else
+            grandParent->set_right(node);
+    }
+};
+template <typename T, int SplayDepth, class Values> typename BinarySplayTree<T, SplayDepth, Values>::Node* BinarySplayTree<T, SplayDepth, Values>::null = nullptr;
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * *  Radix tree with string keys, the backend of        * *
+ * *  BinaryTrees_Strings:                               * *
+ * *    - a node holds only the part of the key between  * *
+ * *      its parent and itself, so a prefix shared by   * *
+ * *      many keys is stored once and compared once     * *
+ * *    - a search reads every byte of the key at most   * *
+ * *      once, however long the prefixes it shares with * *
+ * *      the other keys are                             * *
+ * *    - the first bytes of the children are kept in    * *
+ * *      one sorted array, so the next child is chosen  * *
+ * *      without touching the other ones; the keys are  * *
+ * *      visited in the order of std::string            * *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+   * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+template <typename T, class Values = Values::Auto<>> class BinaryRadixTree
+{
+protected:
+    class Node
+    {
+        std::string prefix_; //The part of the key after the parent's part, empty only in the root
+        std::optional<typename Values::template Slot<T>> data_; //Empty in the nodes which only branch
+        std::string edges_; //The first bytes of the prefixes of the children, as unsigned char in ascending order
+        std::vector<Node*> children_;
+
+    public:
+        Node() = delete;
+        explicit Node(std::string prefix): prefix_(std::move(prefix))
+        {
+
+        }
+
+
+        void update(const T& data)
+        {
+            **data_ = data;
+        }
+
+        T& operator = (const T& data)
+        {
+            **data_ = data;
+            return **data_;
+        }
+
+
+        //Getters:
+        const T& data()
+        {
+            return **data_;
+        }
+        const std::string& prefix()
+        {
+            return prefix_;
+        }
+        bool has_data()
+        {
+            return data_.has_value();
+        }
+
+
+    protected:
+        static void* operator new(size_t)
+        {
+            return Values::template allocateNode<sizeof(Node), alignof(Node)>();
+        }
+        static void operator delete(void* node)
+        {
+            Values::template releaseNode<sizeof(Node), alignof(Node)>(node);
+        }
+
+        static void destroy(Node* node)
+        {
+            node->~Node();
+            operator delete(node);
+        }
+
+        //The position of the child whose prefix starts with the byte, or of the place for such a child:
+        size_t edge_position(unsigned char byte)
+        {
+            auto less = [](char edge, unsigned char value) { return static_cast<unsigned char>(edge) < value; };
+            return size_t(std::lower_bound(edges_.begin(), edges_.end(), byte, less) - edges_.begin());
+        }
+        Node* find_child(unsigned char byte)
+        {
+            size_t position = edge_position(byte);
+            return (position < edges_.size() && static_cast<unsigned char>(edges_[position]) == byte) ? children_[position] : null;
+        }
+
+        void attach(Node* child)
+        {
+            size_t position = edge_position(child->prefix_[0]);
+            edges_.insert(edges_.begin() + std::ptrdiff_t(position), child->prefix_[0]);
+            children_.insert(children_.begin() + std::ptrdiff_t(position), child);
+        }
+        void detach(Node* child)
+        {
+            size_t position = edge_position(child->prefix_[0]);
+            edges_.erase(edges_.begin() + std::ptrdiff_t(position));
+            children_.erase(children_.begin() + std::ptrdiff_t(position));
+        }
+        void replace(Node* child, Node* newChild)
+        {
+            children_[edge_position(child->prefix_[0])] = newChild;
+        }
+
+        friend class BinaryRadixTree;
+    };
+    static Node *null;
+
+
+    Node* search(Node* tree, const std::string& key)
+    {
+        size_t position = 0;
+        for(Node* node = tree; node != null; node = node->find_child(key[position]))
+        {
+            if(key.compare(position, node->prefix_.size(), node->prefix_) != 0) return null;
+
+            position += node->prefix_.size();
+            if(position == key.size()) return node->data_ ? node : null;
+        }
+
+        return null;
+    }
+
+    //Returns false (and keeps the data) if the key is already there:
+    bool insert(Node*& tree, const std::string& key, T* data)
+    {
+        if(tree == null) tree = new Node(std::string());
+
+        Node* node = tree;
+        size_t position = 0;
+        while(position < key.size())
+        {
+            Node* child = node->find_child(key[position]);
+            if(child == null)
+            {
+                child = new Node(key.substr(position));
+                child->data_.emplace(std::move(*data));
+                node->attach(child);
+                return true;
+            }
+
+            size_t common = 0;
+            while(common < child->prefix_.size() && position + common < key.size() && child->prefix_[common] == key[position + common])
+                common++;
+
+            if(common < child->prefix_.size()) //The key leaves the edge in its middle: the edge is split there
+            {
+                Node* branch = new Node(child->prefix_.substr(0, common));
+                node->replace(child, branch);
+                child->prefix_.erase(0, common);
+                branch->attach(child);
+                child = branch;
+            }
+
+            node = child;
+            position += common;
+        }
+
+        if(node->data_) return false;
+        node->data_.emplace(std::move(*data));
+        return true;
+    }
+
+    //Returns false if there was no such key:
+    bool remove(Node*& tree, const std::string& key)
+    {
+        Node* node = tree;
+        Node* parent = null;
+        Node* grandParent = null;
+        size_t position = 0;
+
+        while(node != null)
+        {
+            if(key.compare(position, node->prefix_.size(), node->prefix_) != 0) return false;
+
+            position += node->prefix_.size();
+            if(position == key.size()) break;
+
+            grandParent = parent;
+            parent = node;
+            node = node->find_child(key[position]);
+        }
+        if(node == null || !node->data_) return false;
+
+        node->data_.reset();
+        if(node->children_.empty() && parent != null)
+        {
+            parent->detach(node);
+            Node::destroy(node);
+
+            node = parent;
+            parent = grandParent;
+        }
+        compress(tree, node, parent);
+
+        return true;
+    }
+
+    //Changes the payload of the node in place:
+    template <class Func> Node* modify(Node*&, Node* node, Func& change)
+    {
+        change(**node->data_);
+        return node;
+    }
+
+    //visit(const std::string& key, Node* node) for all keys in their order:
+    template <class Func> void traverseTree(Node* tree, Func& visit)
+    {
+        std::string key;
+        if(tree != null) traverse_process(tree, key, visit);
+    }
+
+    //Only the keys which start with prefix:
+    template <class Func> void traversePrefix(Node* tree, const std::string& prefix, Func& visit)
+    {
+        std::string key;
+        size_t position = 0;
+
+        for(Node* node = tree; node != null; node = node->find_child(prefix[position]))
+        {
+            size_t common = std::min(node->prefix_.size(), prefix.size() - position);
+            if(node->prefix_.compare(0, common, prefix, position, common) != 0) return;
+
+            position += common;
+            if(position == prefix.size())
+            {
+                traverse_process(node, key, visit);
+                return;
+            }
+            key += node->prefix_;
+        }
+    }
+
+    //Only the keys in [low, high):
+    template <class Func> void traverseRange(Node* tree, const std::string& low, const std::string& high, Func& visit)
+    {
+        std::string key;
+        if(tree != null) range_process(tree, key, low, high, visit);
+    }
+
+    int getSizeTree(Node* tree)
+    {
+        int countKeys = 0;
+        auto countKey = [&countKeys](const std::string&, Node*) { countKeys++; };
+        traverseTree(tree, countKey);
+
+        return countKeys;
+    }
+
+    void printTree(Node* tree)
+    {
+        auto print = [](const std::string& key, Node* current) { std::cout << "Node's key: " << key << "  -  Node's value: " << current->data() << "  -  Node's adress: " << current << std::endl; };
+        traverseTree(tree, print);
+    }
+
+    void deleteTree(Node*& tree)
+    {
+        if(tree != null) deleteTree_process(tree);
+        tree = null;
+    }
+
+    //The children are sorted by their first bytes, only the root has an empty prefix and every other node holds data or branches:
+    bool validate(Node* tree)
+    {
+        if(tree == null) return true;
+        if(!tree->prefix_.empty() || (!tree->data_ && tree->children_.empty())) return false;
+
+        return validate_process(tree);
+    }
+
+
+private:
+    //The nodes on the way down from where a walk started, each with the position of its next child to visit:
+    using Path = std::vector<std::pair<Node*, size_t>>;
+
+    //A key can be as deep as it is long, so the walks keep their path on the heap instead of recursing once per level:
+    template <class Func> static void traverse_process(Node* node, std::string& key, Func& visit)
+    {
+        Path path;
+        for(; node != null; node = next_node(path, key))
+        {
+            key += node->prefix_;
+            if(node->data_) visit(key, node);
+            path.emplace_back(node, 0);
+        }
+    }
+
+    //Stops as soon as the keys reach high, so the rest of the tree is not visited:
+    template <class Func> static void range_process(Node* node, std::string& key, const std::string& low, const std::string& high, Func& visit)
+    {
+        Path path;
+        for(; node != null; node = next_node(path, key))
+        {
+            key += node->prefix_;
+            if(key >= high) return; //All keys of the subtree start with key, so none of them is below it, and the later subtrees are larger
+
+            if(key < low && low.compare(0, key.size(), key) != 0) //All keys of the subtree are below low
+            {
+                key.resize(key.size() - node->prefix_.size());
+                continue;
+            }
+            if(node->data_ && key >= low) visit(key, node);
+            path.emplace_back(node, 0);
+        }
+    }
+
+    //Climbs the path until a node has a child left and takes it; the prefixes of the nodes which are left are cut from the key:
+    static Node* next_node(Path& path, std::string& key)
+    {
+        while(!path.empty())
+        {
+            auto& [node, next] = path.back();
+            if(next < node->children_.size()) return node->children_[next++];
+
+            key.resize(key.size() - node->prefix_.size());
+            path.pop_back();
+        }
+
+        return null;
+    }
+
+    //A node without data and with one child is merged into the child, an empty root goes away:
+    void compress(Node*& tree, Node* node, Node* parent)
+    {
+        if(node->data_) return;
+
+        if(node == tree)
+        {
+            if(node->children_.empty())
+            {
+                Node::destroy(node);
+                tree = null;
+            }
+            return;
+        }
+        if(node->children_.size() != 1) return;
+
+        Node* child = node->children_[0];
+        child->prefix_.insert(0, node->prefix_);
+        parent->replace(node, child);
+        Node::destroy(node);
+    }
+
+    static void deleteTree_process(Node* tree)
+    {
+        std::vector<Node*> nodes{tree};
+        while(!nodes.empty())
+        {
+            Node* node = nodes.back();
+            nodes.pop_back();
+            nodes.insert(nodes.end(), node->children_.begin(), node->children_.end());
+            Node::destroy(node);
+        }
+    }
+
+    static bool validate_process(Node* tree)
+    {
+        std::vector<Node*> nodes{tree};
+        while(!nodes.empty())
+        {
+            Node* node = nodes.back();
+            nodes.pop_back();
+            if(node->edges_.size() != node->children_.size()) return false;
+
+            for(size_t i = 0; i < node->children_.size(); i++)
+            {
+                Node* child = node->children_[i];
+                if(child->prefix_.empty() || child->prefix_[0] != node->edges_[i]) return false;
+                if(i > 0 && static_cast<unsigned char>(node->edges_[i - 1]) >= static_cast<unsigned char>(node->edges_[i])) return false;
+                if(!child->data_ && child->children_.size() < 2) return false;
+                nodes.push_back(child);
+            }
+        }
+
+        return true;
+    }
+};
+template <typename T, class Values> typename BinaryRadixTree<T, Values>::Node* BinaryRadixTree<T, Values>::null = nullptr;
+
+
+/* * * * * * * * * * * * * * * * *
+ * * * * * * * * * * * * * * * * * *
+ * *       Access to trees       * *
+ * * * * * * * * * * * * * * * * * *
+   * * * * * * * * * * * * * * * * */
+template <typename T, class Tree = BinaryTrees::BinarySearchTree<T>, class Mutex = ThreadingModel::SingleThreaded, class Cache = LookupCache::None, class Traits = TreeTraits::Default>  class BinaryTrees_API: public Tree, Mutex,
+        public std::conditional<Traits::polymorphic, TreeTraits::Polymorphic, TreeTraits::Monomorphic>::type
+{
+#define ThreadSafe_ON Mutex::lock();
+#define ThreadSafe_OFF Mutex::unlock();
+
+    typename Tree::Node *tree = Tree::null;
+    int count = 0;
+    bool counted = true; //After split() the count is found again only when it is asked for
+    int nextKey = 1; //Keys of append() only grow, even after the largest node is removed
+
+    typename Cache::template Table<typename Tree::Node> cache;
+    Relocations relocations;
+    typename std::conditional<Traits::stats, TreeTraits::Counters, TreeTraits::NoCounters>::type counters;
+    typename Traits::eviction eviction;
+    size_t budget = 0; //Live bytes of the tree, 0 - no limit
+
+#ifdef BINARY_TREES_COROUTINES
+    //One suspended async_*() call, which lives in the frame of its coroutine:
+    struct AsyncOperation
+    {
+        enum Kind { Insert, Search, Remove } kind;
+        int key;
+        std::optional<T> data;
+        bool result = false;
+        std::exception_ptr error = nullptr; //Thrown by the operation, rethrown to its own caller
+        std::coroutine_handle<> waiter = nullptr;
+        AsyncOperation* nextFinished = nullptr; //The combiner chains the executed operations, so nothing is allocated after the log is taken
+    };
+
+    std::mutex asyncMutex; //Guards only the log, never held while the tree is changed
+    std::vector<AsyncOperation*> asyncLog;
+    std::atomic<bool> combining{false};
+#endif
+
+
+    void watch_relocations()
+    {
+        if(cache.enabled)
+            Tree::watchRelocations(&relocations);
+    }
+    //Drops the cached nodes which the last operation has moved or freed:
+    void invalidate_relocations()
+    {
+        if(!cache.enabled) return;
+
+        if(relocations.all)
+            cache.clear();
+        else
+            for(int key : relocations.keys)
+                cache.erase(key);
+
+        relocations.clear();
+    }
+
+    typename Tree::Node *lookup(int key)
+    {
+        typename Tree::Node* node = cache.find(key);
+
+        if(node == Tree::null)
+        {
+            node = Tree::search(tree, key);
+            if(node != Tree::null)
+                cache.store(key, node);
+        }
+
+        if constexpr(Traits::stats)
+        {
+            if(node != Tree::null) counters.hits++;
+            else counters.misses++;
+        }
+        if(node != Tree::null)
+            eviction.used(key);
+        return node;
+    }
+
+    void unlock_access()
+    {
+        ThreadSafe_OFF
+    }
+
+    bool availability_key(int key)
+    {
+        if(lookup(key) == Tree::null)
+            return true;
+        return false;
+    }
+    //The key is known to be free:
+    template <class Data> void insert_new(int key, Data& data)
+    {
+        Tree::insert(tree, key, &data);
+        invalidate_relocations();
+        added(1);
+        reserve_key(key);
+
+        eviction.used(key);
+        enforce_budget();
+    }
+
+    //Returns false if the key was already there, and then replaces its payload only with Duplicates::Overwrite:
+    bool insert_key(int key, T& data)
+    {
+        typename Tree::Node* node = lookup(key);
+        if(node == Tree::null)
+        {
+            insert_new(key, data);
+            return true;
+        }
+
+        if constexpr(Traits::duplicates == TreeTraits::Duplicates::Overwrite)
+        {
+            auto assign = [&data](T& payload) { payload = std::move(data); };
+            Tree::modify(tree, node, assign);
+            invalidate_relocations();
+        }
+        return false;
+    }
+
+    void remove_existing(int key)
+    {
+        eviction.forgotten(key);
+        cache.erase(key);
+        Tree::remove(tree, key);
+        invalidate_relocations();
+        added(-1);
+    }
+
+    int live_count()
+    {
+        if(!Traits::trackedSize || !counted)
+        {
+            count = Tree::getSizeTree(tree);
+            counted = true;
+        }
+        return count;
+    }
+
+    MemoryUsage usage()
+    {
+        MemoryUsage usage = Tree::memoryUsage(tree, size_t(live_count()));
+        eviction.account(usage);
+        return usage;
+    }
+
+    //Removes the victims of the eviction policy until the live memory fits into the budget; the tombstones of Deletion::Lazy
+    //hold memory without data, so they go first, a few per round, and an insert purges only as many as the budget needs:
+    void enforce_budget()
+    {
+        if constexpr(Traits::eviction::enabled)
+        {
+            constexpr size_t purgeSteps = 16;
+
+            while(budget != 0 && tree != Tree::null && usage().live() > budget)
+            {
+                if(purge_tombstones(0, purgeSteps))
+                    continue;
+
+                int key = eviction.victim([this] { return Tree::getMin(tree)->key(); });
+                if(Tree::search(tree, key) == Tree::null) //Without tombstones left the victim must be in the tree
+                {
+                    eviction.forgotten(key);
+                    break;
+                }
+
+                remove_existing(key);
+                if constexpr(Traits::stats)
+                    counters.evictions++;
+            }
+        }
+    }
+
+    //Takes up to steps tombstones of Deletion::Lazy out of the tree; false if there were none or the backend has no purge():
+    template <class U = Tree> auto purge_tombstones(int, size_t steps) -> decltype(U::purge(tree, steps), true)
+    {
+        if(Tree::purge(tree, 0) == 0)
+            return false;
+
+        Tree::purge(tree, steps);
+        invalidate_relocations();
+        return true;
+    }
+    bool purge_tombstones(long, size_t)
+    {
+        return false;
+    }
+
+    //The tree was rebuilt from other nodes: the recency of its keys starts over in the order of the keys
+    void reseed_eviction()
+    {
+        if constexpr(Traits::eviction::recency)
+        {
+            eviction.clear();
+            auto useNode = [this](typename Tree::Node* node) { eviction.used(node->key()); };
+            Tree::traverseTree(tree, useNode);
+        }
+    }
+
+    void added(int nodes)
+    {
+        if constexpr(Traits::trackedSize)
+            count += nodes;
+        if constexpr(Traits::stats)
+        {
+            if(nodes > 0) counters.inserts++;
+            else counters.removes++;
+        }
+    }
+
+    //Two trees are always locked in the order of their addresses, so two threads can not wait for each other:
+    void lock_pair(BinaryTrees_API& other)
+    {
+        BinaryTrees_API* first = (this < &other) ? this : &other;
+        BinaryTrees_API* second = (this < &other) ? &other : this;
+
+        first->Mutex::lock();
+        second->Mutex::lock();
+    }
+    void unlock_pair(BinaryTrees_API& other)
+    {
+        other.Mutex::unlock();
+        Mutex::unlock();
+    }
+
+    //Both trees were rebuilt: nothing cached about them stays valid
+    void restructured(BinaryTrees_API& other)
+    {
+        Tree::adopt(tree);
+        other.Tree::adopt(other.tree);
+
+        cache.clear();
+        relocations.clear();
+        other.cache.clear();
+        other.relocations.clear();
+
+        reseed_eviction();
+        other.reseed_eviction();
+    }
+
+    void reserve_key(int key)
+    {
+        if(key >= nextKey)
+            nextKey = key + 1;
+    }
+
+
+public:
+    /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+     * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+     * *  This container must ensure the following constraints:                                                      * *
+     * *    - the key of each node of the tree is unique!                                                            * *
+     * *    - new nodes can be added:                                                                                * *
+     * *        * by explicitly specifying the key                                                                   * *
+     * *          (in this case, the node may not be created if such a key already exists -                          * *
+     * *          the user will be notified of the success of the operation by boolean values                        * *
+     * *          returned from the corresponding function)                                                          * *
+     * *        * by passing only the data that should be stored in the tree                                         * *
+     * *          (then the key is assigned to such data automatically)                                              * *
+     * *    - nodes can be deleted only by the obtained key value, or all nodes of the tree can be deleted at once,  * *
+     * *      or the tree itself can be deleted!                                                                     * *
+     * *    - it is also possible to get the number of nodes in the tree                                             * *
+     * *    - it is possible to get any node in the tree                                                             * *
+     * *    - output to the console of all elements of the tree                                                      * *
+     * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+       * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+    /*
+    //Данный контейнер, должен обеспечивать гарантировать следующие ограничения:
+    // - ключ каждого узла дерева - уникален!
+    // - добавлять новые узлы можно:
+    //   * явно задавая ключ (в этом случае узел может быть не создан, если такой ключ уже есть - об успехе операции пользователь будет уведомлён булевыми значениями, возращенными из соответствующей функции)
+    //   * передавая лишь сами данные, которые должны быть сохранены в дереве (тогда ключ таким данным назначается автоматически)
+    // - удалять узлы можно лишь по полученному значению ключа, либо удалять все узлы дерева разом, либо удалять само дерево!
+    // - можно также получить количество узлов в дереве
+    // - можно получить любой узел в дереве
+    // - вывод в консоль всех элементов дерева
+    */
+
+    explicit BinaryTrees_API()
+    {
+        watch_relocations();
+    }
+    explicit BinaryTrees_API(int key, T data)
+    {
+        watch_relocations();
+
+        ThreadSafe_ON
+
+        Tree::insert(tree, key, &data); //По умолчанию, при создании данного дерева, узлов в нём нет, а потому любой ключ доступен, в отличии от добавления в уже созданый контейнер!
+        count = 1;
+        reserve_key(key);
+
+        ThreadSafe_OFF
+    }
+    ~BinaryTrees_API()
+    {
+        deleteTree();
+    }
+
+    /* * * * * * * * * * * * * * * * * * * * * * * * * * *
+     * *      If the user does not specify the key       * *
+     * *        they need, then the key is found         * *
+     * *     automatically and the user should know      * *
+     * *  it, so the key is returned from the function!  * *
+     * *  The key is taken from a sequence which is      * *
+     * *  always above the largest key of the tree, so   * *
+     * *  the node goes to the end of the tree at once   * *
+       * * * * * * * * * * * * * * * * * * * * * * * * * * */
+    int append(T data)
+    {
+        ThreadSafe_ON
+
+        int key = nextKey++;
+
+        Tree::appendTree(tree, key, &data);
+        invalidate_relocations();
+        added(1);
+
+        eviction.used(key);
+        enforce_budget();
+
+        ThreadSafe_OFF
+
+        return key;
+    }
+
+    /* * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+     * *   If a node with the required key already exists,   * *
+     * *   the node insertion does not occur, and the user   * *
+     * *         is explicitly notified about it             * *
+     * *   (with Duplicates::Overwrite its data is replaced) * *
+       * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+    bool insert(int key, T data)
+    {
+        ThreadSafe_ON
+
+        bool inserted = insert_key(key, data);
+
+        ThreadSafe_OFF
+
+        return inserted;
+    }
+
+    /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+     * *  Changes in place, with one search under the lock:    * *
+     * *    - update(key, change) - change(T& data) is applied * *
+     * *      to the stored payload; false if there is no key  * *
+     * *    - upsert(key, data) - assigns the data or inserts  * *
+     * *      it; upsert(key, change) - applies change to the  * *
+     * *      payload or to a new T() which is then inserted;  * *
+     * *      both return true if a node was inserted          * *
+     * *    - emplace(key, args...) - inserts T(args...) if    * *
+     * *      the key is free, like insert(); the payload      * *
+     * *      is built once, where the node keeps it           * *
+       * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+    template <class Func> bool update(int key, Func change)
+    {
+        ThreadSafe_ON
+
+        typename Tree::Node* node = lookup(key);
+        if(node != Tree::null)
+        {
+            Tree::modify(tree, node, change);
+            invalidate_relocations();
+        }
+
+        ThreadSafe_OFF
+
+        return node != Tree::null;
+    }
+
+    template <class Func, typename = typename std::enable_if<std::is_invocable<Func&, T&>::value>::type> bool upsert(int key, Func change)
+    {
+        ThreadSafe_ON
+
+        typename Tree::Node* node = lookup(key);
+        if(node != Tree::null)
+        {
+            Tree::modify(tree, node, change);
+            invalidate_relocations();
+        }
+        else
+        {
+            T data = T();
+            change(data);
+            insert_new(key, data);
+        }
+
+        ThreadSafe_OFF
+
+        return node == Tree::null;
+    }
+
+    bool upsert(int key, T data)
+    {
+        return upsert(key, [&data](T& payload) { payload = std::move(data); });
+    }
+
+    template <class... Args> bool emplace(int key, Args&&... args)
+    {
+        ThreadSafe_ON
+
+        if(!availability_key(key))
+        {
+            ThreadSafe_OFF
+            return false;
+        }
+        Values::Emplace<T, Args...> data{std::forward_as_tuple(std::forward<Args>(args)...)};
+        insert_new(key, data);
+
+        ThreadSafe_OFF
+
+        return true;
+    }
+
+    typename Tree::Node *search(int key)
+    {
+        ThreadSafe_ON
+
+        typename Tree::Node* node = lookup(key);
+
+        if(Traits::throwingSearch && node == Tree::null)
+        {
+            ThreadSafe_OFF
+            throw std::out_of_range("Out of range! Node not found in the three..."); //Выкидываем исключение, с выводом сообщения об ошибке, либо:
+            //or
+            //std::cout << " <<  Warning! No data was found! Instead of the data, the empty stub is returned...  >> " << std::endl;
+            //return new typename Tree::Node(0, new T()); //Возращаем пустую заглушку
+        }
+
+        ThreadSafe_OFF
+
+        return node;
+    }
+
+    /* * * * * * * * * * * * * * * * * * * * * * * * * * *
+     * *  Lookups without exceptions - a missing key is  * *
+     * *  an ordinary result here, not an error:         * *
+     * *    - contains(key) - is there such a key        * *
+     * *    - find(key) - a copy of the data or nullopt  * *
+     * *    - try_get(key, out) - copies the data into   * *
+     * *      out and returns true if the key exists     * *
+     * *    - get_or(key, default) - the data or default * *
+       * * * * * * * * * * * * * * * * * * * * * * * * * * */
+    bool contains(int key)
+    {
+        ThreadSafe_ON
+
+        bool found = (lookup(key) != Tree::null);
+
+        ThreadSafe_OFF
+
+        return found;
+    }
+
+    std::optional<T> find(int key)
+    {
+        ThreadSafe_ON
+
+        typename Tree::Node* node = lookup(key);
+        std::optional<T> data = (node == Tree::null) ? std::nullopt : std::optional<T>(node->data());
+
+        ThreadSafe_OFF
+
+        return data;
+    }
+
+    bool try_get(int key, T& out)
+    {
+        ThreadSafe_ON
+
+        typename Tree::Node* node = lookup(key);
+        bool found = (node != Tree::null);
+        if(found)
+            out = node->data();
+
+        ThreadSafe_OFF
+
+        return found;
+    }
+
+    T get_or(int key, T default_data)
+    {
+        ThreadSafe_ON
+
+        typename Tree::Node* node = lookup(key);
+        if(node != Tree::null)
+            default_data = node->data();
+
+        ThreadSafe_OFF
+
+        return default_data;
+    }
+
+    /* * * * * * * * * * * * * * * * * * * * * * * * * * * *
+     * *  Handle of one node: while the accessor is alive   * *
+     * *  the tree stays locked (for the _p trees), so the  * *
+     * *  node can not be moved or freed by other threads,  * *
+     * *  and the payload is read and changed without a     * *
+     * *  second search. The tree itself must not be used   * *
+     * *  by the owner of the accessor until it is released * *
+       * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+    class Accessor
+    {
+        BinaryTrees_API* owner_ = nullptr;
+        typename Tree::Node* node_ = Tree::null;
+
+    public:
+        Accessor() = default;
+        explicit Accessor(BinaryTrees_API* owner, typename Tree::Node* node): owner_(owner), node_(node)
+        {
+
+        }
+        Accessor(const Accessor&) = delete;
+        Accessor& operator = (const Accessor&) = delete;
+        Accessor(Accessor&& other) noexcept: owner_(other.owner_), node_(other.node_)
         {
-            key_ = cur_key;
+            other.owner_ = nullptr;
+            other.node_ = Tree::null;
         }
-        void set_data(T* data)
+        Accessor& operator = (Accessor&& other) noexcept
         {
-            *data_ = *data;
+            std::swap(owner_, other.owner_);
+            std::swap(node_, other.node_);
+            return *this;
         }
-        void set_left(Node* cur_left)
+        ~Accessor()
         {
-            left_ = cur_left;
+            release();
         }
-        void set_right(Node* cur_right)
+
+        explicit operator bool() const
         {
-            right_ = cur_right;
+            return node_ != Tree::null;
         }
 
-        //Getters:
         int key()
         {
-            return key_;
+            return node_->key();
         }
-        const T data()
+        decltype(auto) data()
         {
-            return* data_;
+            return node_->data();
         }
-        Node* get_left()
+
+        //change(T& data) is applied to the payload of the node itself:
+        template <class Func> void modify(Func change)
         {
-            return left_;
+            node_ = owner_->Tree::modify(owner_->tree, node_, change);
+            owner_->invalidate_relocations();
         }
-        Node* get_right()
+        void update(const T& data)
         {
-            return right_;
+            modify([&data](T& payload) { payload = data; });
         }
 
+        void release()
+        {
+            if(owner_ != nullptr)
+                owner_->unlock_access();
 
-protected:
-        template <typename U = T>
-        void operator delete(void* ptr, U); //! Либо вместо U использовать - typename std::enable_if<!std::is_same<U, BinarySearchTree>::value>::type* = nullptr - это механизм позволяющий контролировать, что объекту, который захочет удалить Node, разрешено это делать - на самом деле не работает в данном случае, так что это просто как вариант действий
+            owner_ = nullptr;
+            node_ = Tree::null;
+        }
+    };
 
-        static void destroy(Node* node)
+    //An empty accessor (and no lock) if there is no such key:
+    Accessor access(int key)
+    {
+        ThreadSafe_ON
+
+        typename Tree::Node* node = lookup(key);
+        if(node == Tree::null)
         {
-            node->~Node();
-            free(node);
+            ThreadSafe_OFF
+            return Accessor();
         }
 
-        friend class BinarySearchTree;
-    };
-    static Node *null;
+        return Accessor(this, node);
+    }
+
+    /* * * * * * * * * * * * * * * * * * * * * * * * * *
+     * *  Only for the persistent trees: O(1) view of  * *
+     * *  the current version of the tree, which can   * *
+     * *  be read without locks while writers go on    * *
+       * * * * * * * * * * * * * * * * * * * * * * * * * */
+    template <class U = Tree> typename U::Snapshot snapshot()
+    {
+        ThreadSafe_ON
+
+        typename U::Snapshot snapshot(*this, tree);
+
+        ThreadSafe_OFF
 
+        return snapshot;
+    }
 
-    void insert(Node* __restrict node, int key, T* __restrict data)
+    /* * * * * * * * * * * * * * * * * * * * * * * * *
+     * *  Only for the persistent trees with epoch   * *
+     * *  reclamation: takes no lock at all, the     * *
+     * *  reader sees the latest published version   * *
+     * *  until it is destroyed                      * *
+       * * * * * * * * * * * * * * * * * * * * * * * * */
+    template <class U = Tree> typename U::Reader read() const
     {
-        insert_process(node, key, data);
+        return typename U::Reader(*this);
     }
 
-    //Поиск узлов дерева:
-    Node* search(Node* node, int key)
+    /* * * * * * * * * * * * * * * * * * * * * * * * *
+     * *  Only for the pool-backed trees: dense     * *
+     * *  re-layout of the nodes and checkpoints    * *
+     * *  of the whole tree as one block of memory  * *
+       * * * * * * * * * * * * * * * * * * * * * * * * */
+    void compact(NodeOrder order = NodeOrder::InOrder)
     {
-        if(node == null) return null;
-        if(node->key() == key) return node;
+        ThreadSafe_ON
 
-        return (key < node->key()) ? search(node->get_left(), key) : search(node->get_right(), key);
+        Tree::compact(tree, order);
+        invalidate_relocations();
+
+        ThreadSafe_OFF
     }
 
-    Node* getMin(Node* node)
+    bool save(std::ostream& out)
     {
-        if(node == null) return null;
-        if(node->set_left(null)) return node;
-        return getMin(node->get_left());
+        ThreadSafe_ON
+
+        bool saved = Tree::save(out);
+
+        ThreadSafe_OFF
+
+        return saved;
     }
 
-    Node* getMax(Node* node)
+    bool load(std::istream& in)
     {
-        if(node == null) return null;
-        if(node->get_right() == null) return node;
-        return getMax(node->get_right());
+        ThreadSafe_ON
+
+        bool loaded = Tree::load(in, tree);
+        invalidate_relocations();
+        if(loaded)
+        {
+            count = Tree::getSizeTree(tree);
+            counted = true;
+            if(count) reserve_key(Tree::getMax(tree)->key());
+
+            reseed_eviction();
+            enforce_budget();
+        }
+
+        ThreadSafe_OFF
+
+        return loaded;
     }
 
-    void remove(Node*& node, int key)
+    /* * * * * * * * * * * * * * * * * * * * * * * *
+     * *  Visits all nodes in the order of keys:   * *
+     * *    visit(int key, const T& data)          * *
+       * * * * * * * * * * * * * * * * * * * * * * */
+    template <class Func> void forEach(Func visit)
     {
-        node = remove_process(node, key);
+        ThreadSafe_ON
+
+        auto visitNode = [&visit](typename Tree::Node* node) { visit(node->key(), node->data()); };
+        Tree::traverseTree(tree, visitNode);
+
+        ThreadSafe_OFF
     }
 
-    //Дополнительный функционал дерева:
-    void printTree(Node* node)
+    /* * * * * * * * * * * * * * * * * * * * * * * * * *
+     * *  Only for the interval trees: visits all     * *
+     * *  intervals containing the point or crossing  * *
+     * *  the range: visit(int low, const T& data)    * *
+       * * * * * * * * * * * * * * * * * * * * * * * * */
+    template <class Func> void overlaps(int point, Func visit)
     {
-        if(node == null) return;
-        printTree(node->get_right());
-        printTree(node->get_left());
-        std::cout << "Node's key: " << node->key() << "  -  Node's value: " << node->data() << "  -  Node's adress: " << node << std::endl;
+        overlaps(point, point, visit);
     }
 
-    void deleteTree(Node*& node)
+    template <class Func> void overlaps(int low, int high, Func visit)
     {
-        if(node == null) return;
-
-        Node* delLeft = node->get_left();
-        Node* delRight = node->get_right();
+        ThreadSafe_ON
 
-        deleteTree(delLeft);
-        deleteTree(delRight);
+        auto visitNode = [&visit](typename Tree::Node* node) { visit(node->key(), node->data()); };
+        Tree::overlaps(tree, low, high, visitNode);
 
-        Node::destroy(node);
-        node = null;
+        ThreadSafe_OFF
     }
 
-    void copyTree(Node* node_donor, Node* node_recipient)
+#ifdef BINARY_TREES_COROUTINES
+    /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+     * *  C++20 coroutines: co_await async_insert(key, data),      * *
+     * *  async_search(key) (nullopt on a miss), async_remove(key) * *
+     * *  (true if the node was there). The operations go to the   * *
+     * *  log of the tree; the first caller which finds nobody     * *
+     * *  combining becomes the combiner: it executes the whole    * *
+     * *  log under one lock, and later resumes the waiting        * *
+     * *  coroutines on its own thread. The others do not block    * *
+     * *  their threads - they are just suspended. The tree must   * *
+     * *  not be destroyed while such calls are pending            * *
+       * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+    template <typename Result> class AsyncAwaitable
     {
-        if(node_donor == null) return;
-        copyTree(node_donor->get_right(), node_recipient->get_right());
-        copyTree(node_donor->get_left(), node_recipient->get_left());
-        node_recipient->set_key(node_donor->key());
-        node_recipient->set_data(node_donor->data());
-    }
+        BinaryTrees_API* owner_;
+        AsyncOperation operation_;
 
-    int getSizeTree(Node* node)
+    public:
+        explicit AsyncAwaitable(BinaryTrees_API* owner, typename AsyncOperation::Kind kind, int key, std::optional<T> data = std::nullopt): owner_(owner), operation_{kind, key, std::move(data)}
+        {
+
+        }
+
+        bool await_ready()
+        {
+            return false;
+        }
+        bool await_suspend(std::coroutine_handle<> waiter)
+        {
+            operation_.waiter = waiter;
+            return owner_->combine(&operation_);
+        }
+        Result await_resume()
+        {
+            if(operation_.error) std::rethrow_exception(operation_.error);
+
+            if constexpr(std::is_same<Result, bool>::value)
+                return operation_.result;
+            else
+                return std::move(operation_.data);
+        }
+    };
+
+    AsyncAwaitable<bool> async_insert(int key, T data)
     {
-        int countNodes = 0;
-        checkSizeTree_process(node, &countNodes);
+        return AsyncAwaitable<bool>(this, AsyncOperation::Insert, key, std::move(data));
+    }
 
-        return countNodes;
+    AsyncAwaitable<std::optional<T>> async_search(int key)
+    {
+        return AsyncAwaitable<std::optional<T>>(this, AsyncOperation::Search, key);
     }
 
+    AsyncAwaitable<bool> async_remove(int key)
+    {
+        return AsyncAwaitable<bool>(this, AsyncOperation::Remove, key);
+    }
 
 private:
-    void insert_process(Node* __restrict node, int key, T* __restrict data)
+    //The tree is locked while the combiner executes a batch; the lock and the combiner's role are given up even if the batch is left by an exception:
+    class CombinerLock
     {
-        if(key < node->key())
+        BinaryTrees_API& owner_;
+
+    public:
+        explicit CombinerLock(BinaryTrees_API& owner): owner_(owner)
         {
-            if(node->get_left() == null) node->set_left(new Node(key, data));
-            else insert_process(node->get_left(), key, data);
+            owner_.Mutex::lock();
         }
-        else if(key >= node->key())
+        CombinerLock(const CombinerLock&) = delete;
+        CombinerLock& operator = (const CombinerLock&) = delete;
+        ~CombinerLock()
         {
-            if(node->get_right() == null) node->set_right(new Node(key, data));
-            else insert_process(node->get_right(), key, data);
+            owner_.Mutex::unlock();
+            owner_.combining.store(false, std::memory_order_release);
+        }
+    };
+
+    //An exception of one operation (e.g. bad_alloc) belongs to its caller, the rest of the batch goes on:
+    void execute(AsyncOperation* operation)
+    {
+        try
+        {
+            switch(operation->kind)
+            {
+            case AsyncOperation::Insert:
+                operation->result = insert_key(operation->key, *operation->data);
+                break;
+            case AsyncOperation::Search:
+            {
+                typename Tree::Node* node = lookup(operation->key);
+                if(node != Tree::null) operation->data.emplace(node->data());
+                break;
+            }
+            case AsyncOperation::Remove:
+                operation->result = !availability_key(operation->key);
+                if(operation->result)
+                    remove_existing(operation->key);
+                break;
+            }
+        }
+        catch(...)
+        {
+            operation->error = std::current_exception();
         }
     }
 
-    Node* remove_process(Node *node, int key)
+    //Returns false if the own operation was done by this call, so the caller goes on without suspending;
+    //a combiner which was finishing when it was logged may have taken it, and that one resumes the caller
+    bool combine(AsyncOperation* own)
     {
-        if(node == null) return null;
-        else if(key < node->key()) node->set_left(remove_process(node->get_left(), key));
-        else if(key > node->key()) node->set_right(remove_process(node->get_right(), key));
-        else
         {
-            if(node->get_left() == null && node->get_right() == null)
+            std::lock_guard<std::mutex> guard(asyncMutex);
+            asyncLog.push_back(own);
+        }
+        if(combining.exchange(true, std::memory_order_acq_rel))
+            return true; //The combiner will resume us
+
+        AsyncOperation* finished = nullptr;
+        bool ownDone = false;
+        do
+        {
+            std::vector<AsyncOperation*> batch;
             {
-                Node::destroy(node);
-                node = null;
+                std::lock_guard<std::mutex> guard(asyncMutex);
+                batch.swap(asyncLog);
             }
-            else if(node->get_left() == null || node->get_right() == null)
+
             {
-                Node* temp = node;
-                node = (node->get_left() == null) ? node->get_right() : node->get_left();
+                CombinerLock lock(*this);
 
-                Node::destroy(temp);
+                for(AsyncOperation* operation : batch)
+                {
+                    execute(operation);
+                    ownDone = ownDone || operation == own;
+                }
             }
-            else
+            for(AsyncOperation* operation : batch)
             {
-                Node* maxInLeft = getMax(node->get_left());
-                T max_data = maxInLeft->data();
-
-                node->set_key(maxInLeft->key());
-                node->set_data(&max_data);
-                node->set_left(remove_process(node->get_left(), node->key()));
+                operation->nextFinished = finished;
+                finished = operation;
             }
+
+            std::lock_guard<std::mutex> guard(asyncMutex);
+            if(asyncLog.empty()) break;
         }
+        while(!combining.exchange(true, std::memory_order_acq_rel)); //Operations came while combining and nobody took them
 
-        return node;
+        while(finished != nullptr)
+        {
+            AsyncOperation* operation = finished;
+            finished = operation->nextFinished; //The resumed coroutine may destroy the operation
+            if(operation != own)
+                operation->waiter.resume();
+        }
+
+        return !ownDone;
     }
 
-    void checkSizeTree_process(Node *node, int *count)
+public:
+#endif
+
+    //Only with a lookup cache: how many searches were answered by the cache and how many went to the tree
+    size_t cacheHits()
     {
-        if(node == null) return;
-        checkSizeTree_process(node->get_left(), count);
-        *count += 1;
-        checkSizeTree_process(node->get_right(), count);
+        ThreadSafe_ON
+
+        size_t hits = cache.hits();
+
+        ThreadSafe_OFF
+
+        return hits;
     }
 
-};
-template <typename T> typename BinarySearchTree<T>::Node *BinarySearchTree<T>::null = nullptr;
+    size_t cacheMisses()
+    {
+        ThreadSafe_ON
 
-template <typename T> class BinaryABLTree
-{
-protected:
-    class Node
+        size_t misses = cache.misses();
+
+        ThreadSafe_OFF
+
+        return misses;
+    }
+
+    //Only with TreeTraits::stats: the inserted and removed nodes and the lookups with and without the key
+    TreeTraits::Counters stats()
     {
-        int key_;
-        T* data_;
-        size_t height_ = 0;
+        static_assert(Traits::stats, "stats() needs a traits bundle with stats = true, e.g. TreeTraits::Profiled");
 
-        Node* left_ = null;
-        Node* right_ = null;
+        ThreadSafe_ON
 
+        TreeTraits::Counters snapshot = counters;
 
-    public:
-        Node() = delete;
-        explicit Node(int key, T* data): key_(key), data_(new T(*data))
-        {
+        ThreadSafe_OFF
 
-        }
+        return snapshot;
+    }
 
+    /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+     * *  Only for BinaryABLTree and BinaryRedBlackTree with    * *
+     * *  Deletion::Lazy: takes up to steps tombstones out of   * *
+     * *  the tree under the lock, returns the number of the    * *
+     * *  ones left. A maintenance thread can call purge(64)    * *
+     * *  in a loop to keep the writers free of this work       * *
+       * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+    size_t purge(size_t steps = SIZE_MAX)
+    {
+        ThreadSafe_ON
 
-        void update(const T data)
-        {
-            *data_ = data;
-        }
+        size_t left = Tree::purge(tree, steps);
+        invalidate_relocations();
 
-        T& operator = (const T data)
-        {
-            *data_ = data;
-        }
+        ThreadSafe_OFF
 
-        //Setters:
-        void set_key(int cur_key)
-        {
-            key_ = cur_key;
-        }
-        void set_data(T* data)
-        {
-            *data_ = *data;
-        }
-        void set_left(Node* cur_left)
-        {
-            left_ = cur_left;
-        }
-        void set_right(Node* cur_right)
-        {
-            right_ = cur_right;
-        }
+        return left;
+    }
 
-        //Getters:
-        int key()
-        {
-            return key_;
-        }
-        const T data()
-        {
-            return* data_;
-        }
-        Node* get_left()
-        {
-            return left_;
-        }
-        Node* get_right()
-        {
-            return right_;
-        }
+    /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+     * *  Only for BinaryABLTree and BinaryRedBlackTree:         * *
+     * *    - split(key, right) - the nodes with keys >= key    * *
+     * *      move to right (its own nodes are deleted), in     * *
+     * *      O(log n); the sizes are counted again lazily      * *
+     * *    - join(right) - takes all nodes of right if all     * *
+     * *      its keys are larger than the keys of this tree,   * *
+     * *      in O(log n); false (and nothing is done) if not   * *
+     * *    - merge(other) - takes all nodes of other with any  * *
+     * *      keys, in linear time; on equal keys the node of   * *
+     * *      this tree stays                                   * *
+     * *  The tombstones of Deletion::Lazy are purged first     * *
+       * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+    void split(int key, BinaryTrees_API& right)
+    {
+        if(&right == this) return;
+        lock_pair(right);
 
+        Tree::purge(tree, SIZE_MAX);
+        right.Tree::deleteTree(right.tree);
+        right.tree = Tree::null;
 
-    protected:
-        template <typename U = T>
-        void operator delete(void* ptr, U); //! Либо вместо U использовать - typename std::enable_if<!std::is_same<U, BinarySearchTree>::value>::type* = nullptr - это механизм позволяющий контролировать, что объекту, который захочет удалить Node, разрешено это делать - на самом деле не работает в данном случае, так что это просто как вариант действий
+        Tree::split(tree, key, right.tree);
+        restructured(right);
+
+        counted = right.counted = false;
+        if(right.tree != Tree::null)
+            right.reserve_key(Tree::getMax(right.tree)->key());
+
+        unlock_pair(right);
+    }
+
+    bool join(BinaryTrees_API& right)
+    {
+        if(&right == this) return false;
+        lock_pair(right);
+
+        Tree::purge(tree, SIZE_MAX);
+        right.Tree::purge(right.tree, SIZE_MAX);
 
-        static void destroy(Node* node)
+        bool ordered = (tree == Tree::null || right.tree == Tree::null || Tree::getMax(tree)->key() < Tree::getMin(right.tree)->key());
+        if(ordered)
         {
-            node->~Node();
-            free(node);
+            Tree::join(tree, right.tree);
+            restructured(right);
+
+            count += right.count;
+            counted = counted && right.counted;
+            reserve_key(right.nextKey - 1);
+
+            right.count = 0;
+            right.counted = true;
         }
 
-        friend class BinaryABLTree;
-    };
-    static Node *null;
+        unlock_pair(right);
 
+        return ordered;
+    }
 
-    void insert(Node* __restrict node, int key, T* __restrict data)
+    void merge(BinaryTrees_API& other)
     {
-        insert_process(node, key, data);
+        if(&other == this) return;
+        lock_pair(other);
+
+        Tree::purge(tree, SIZE_MAX);
+        other.Tree::purge(other.tree, SIZE_MAX);
+
+        Tree::merge(tree, other.tree);
+        restructured(other);
+
+        count = Tree::getSizeTree(tree);
+        counted = true;
+        reserve_key(other.nextKey - 1);
+
+        other.count = 0;
+        other.counted = true;
+
+        unlock_pair(other);
     }
 
-    void remove(Node*& node, int key)
+    int size()
     {
-        node = remove_process(node, key);
+        ThreadSafe_ON
+
+        int size = live_count();
+
+        ThreadSafe_OFF
+
+        return size;
     }
 
-    //Поиск узлов дерева:
-    Node* search(Node* node, int key)
+    /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+     * *  Bytes of the nodes, of the payloads kept out of the  * *
+     * *  nodes and of the allocator around them, in O(1)     * *
+     * *  with a tracked size; the tree object itself is in   * *
+     * *  reservedBytes                                       * *
+       * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+    MemoryUsage memory_usage()
     {
-        if(node == null) return null;
-        if(node->key() == key) return node;
+        ThreadSafe_ON
 
-        return (key < node->key()) ? search(node->get_left(), key) : search(node->get_right(), key);
+        MemoryUsage memory = usage();
+        memory.reservedBytes += sizeof(*this);
+
+        ThreadSafe_OFF
+
+        return memory;
     }
 
-    Node* getMin(Node* node)
+    /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+     * *  Only with an eviction policy in the traits (e.g.    * *
+     * *  TreeTraits::Bounded): after every insert the        * *
+     * *  victims of the policy are removed until the live    * *
+     * *  bytes of memory_usage() fit into the budget, so the * *
+     * *  tree works as a bounded cache. 0 - no limit         * *
+       * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+    void set_memory_budget(size_t bytes)
     {
-        if(node == null) return null;
-        if(node->get_left() == null) return node;
-        return getMin(node->get_left());
+        static_assert(Traits::eviction::enabled, "set_memory_budget() needs an eviction policy in the traits, e.g. TreeTraits::Bounded");
+        static_assert(Traits::trackedSize, "the memory budget is checked after every insert and needs trackedSize = true");
+
+        ThreadSafe_ON
+
+        budget = bytes;
+        enforce_budget();
+
+        ThreadSafe_OFF
     }
-    Node* getMax(Node* node)
+    //Checks the invariants of the backend and the count of the nodes - in linear time, for debugging and stress runs
+    bool validate()
     {
-        if(node == null) return null;
-        if(node->get_right() == null) return node;
-        return getMax(node->get_right());
+        ThreadSafe_ON
+
+        bool valid = Tree::validate(tree) && (!Traits::trackedSize || !counted || count == Tree::getSizeTree(tree));
+
+        ThreadSafe_OFF
+
+        return valid;
     }
 
-    //Дополнительный функционал дерева:
-    void printTree(Node* node)
+    void printTree()
     {
-        if(node == null) return;
-        printTree(node->get_right());
-        printTree(node->get_left());
-        std::cout << "Node's key: " << node->key_ << "  -  Node's value: " << node->data() << "  -  Node's adress: " << node << std::endl;
+        ThreadSafe_ON
+
+        Tree::printTree(tree);
+
+        ThreadSafe_OFF
     }
 
-    void deleteTree(Node*& node)
+    void remove(int key)
     {
-        if(node == null) return;
+        ThreadSafe_ON
 
-        Node* delLeft = node->get_left();
-        Node* delRight = node->get_right();
+        if(!availability_key(key))
+            remove_existing(key);
 
-        deleteTree(delLeft);
-        deleteTree(delRight);
+        ThreadSafe_OFF
+    }
+    void deleteTree()
+    {
+        ThreadSafe_ON
 
-        Node::destroy(node);
-        node = null;
+        Tree::deleteTree(tree);
+        tree = Tree::null;
+        count = 0;
+        counted = true;
+        nextKey = 1;
+
+        cache.clear();
+        relocations.clear();
+        eviction.clear();
+
+        ThreadSafe_OFF
     }
+};
 
-    void copyTree(Node* node_donor, Node* node_recipient)
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * *  Sharded container of trees:                        * *
+ * *    - the keys are spread over N independent trees   * *
+ * *      by the key modulo N, and every shard has its   * *
+ * *      own lock, so writers of different shards do    * *
+ * *      not wait for each other                        * *
+ * *    - append() takes a key from the shard of the     * *
+ * *      calling thread: shard s hands out the keys     * *
+ * *      s, s + N, s + 2N..., so the shards never have  * *
+ * *      to agree on the keys                           * *
+ * *    - forEach() merges the shards in the key order   * *
+ * *      (every shard is consistent on its own, not all * *
+ * *      of them at one moment)                         * *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+   * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+template <typename T, class Tree = BinaryTrees::BinaryRedBlackTree<T>, class Mutex = ThreadingModel::ObjectLevelLockable> class BinaryTrees_Sharded
+{
+    typedef BinaryTrees_API<T, Tree, Mutex> Shard;
+
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::unique_ptr<std::atomic<int>[]> nextKeys; //The next key which append() will try in each shard
+
+
+    int shard_of(int key)
     {
-        if(node_donor == null) return;
-        copyTree(node_donor->get_right(), node_recipient->get_right());
-        copyTree(node_donor->get_left(), node_recipient->get_left());
-        node_recipient->set_key(node_donor->key());
-        *node_recipient->set_data(&node_donor->data());
+        int count = int(shards.size());
+        return ((key % count) + count) % count;
     }
 
-    int getSizeTree(Node* node)
+    int first_key(int shard)
     {
-        int countNodes = 0;
-        checkSizeTree_process(node, &countNodes);
-
-        return countNodes;
+        return (shard == 0) ? int(shards.size()) : shard;
     }
 
-
-private:
-    void insert_process(Node* __restrict node, int key, T* __restrict data)
+    //Explicitly inserted keys move the shard's sequence past them:
+    void raise_next_key(int shard, int key)
     {
-        if(key < node->key())
-        {
-            if(node->get_left() == null) node->set_left(new Node(key, data));
-            else insert_process(node->get_left(), key, data);
-        }
-        else if(key >= node->key())
+        int next = nextKeys[shard].load(std::memory_order_relaxed);
+        while(next <= key && !nextKeys[shard].compare_exchange_weak(next, key + int(shards.size()), std::memory_order_relaxed))
         {
-            if(node->get_right() == null) node->set_right(new Node(key, data));
-            else insert_process(node->get_right(), key, data);
+
         }
+    }
 
-        updateHeight(node);
-        balance(node);
+
+public:
+    explicit BinaryTrees_Sharded(int count = 16): nextKeys(new std::atomic<int>[count > 0 ? count : 1])
+    {
+        for(int i = 0; i < (count > 0 ? count : 1); i++)
+            shards.emplace_back(new Shard());
+
+        //first_key() depends on the number of the shards, so the sequences start only when all of them exist:
+        for(size_t i = 0; i < shards.size(); i++)
+            nextKeys[i].store(first_key(int(i)), std::memory_order_relaxed);
     }
 
-    Node* remove_process(Node* node, int key)
+    int append(T data)
     {
-        if(node == null) return null;
-        else if(key < node->key()) node->set_left(remove_process(node->get_left(), key));
-        else if(key > node->key()) node->set_right(remove_process(node->get_right(), key));
-        else
-        {
-            if(node->get_left() == null && node->get_right() == null)
-            {
-                Node::destroy(node);
-                node = null;
-            }
-            else if(node->get_left() == null || node->get_right() == null)
-            {
-                Node* temp = node;
-                node = (node->get_left() == null) ? node->get_right() : node->get_left();
+        int shard = int(std::hash<std::thread::id>()(std::this_thread::get_id()) % shards.size());
+        int key = nextKeys[shard].fetch_add(int(shards.size()), std::memory_order_relaxed);
 
-                Node::destroy(temp);
-            }
-            else
-            {
-                Node* maxInLeft = getMax(node->get_left());
-                T max_data = maxInLeft->data();
+        while(!shards[shard]->insert(key, data)) //The key was taken by an explicit insert() at the same moment
+            key = nextKeys[shard].fetch_add(int(shards.size()), std::memory_order_relaxed);
 
-                node->set_key(maxInLeft->key());
-                node->set_data(&max_data);
-                node->set_left(remove_process(node->get_left(), node->key()));
-            }
-        }
+        return key;
+    }
 
-        if(node != null)
-        {
-            updateHeight(node);
-            balance(node);
-        }
+    bool insert(int key, T data)
+    {
+        int shard = shard_of(key);
+        raise_next_key(shard, key);
 
-        return node;
+        return shards[shard]->insert(key, std::move(data));
     }
 
-    void checkSizeTree_process(Node *node, int *count)
+    auto search(int key)
     {
-        if(node == null) return;
-        checkSizeTree_process(node->get_left(), count);
-        *count += 1;
-        checkSizeTree_process(node->get_right(), count);
+        return shards[shard_of(key)]->search(key);
     }
 
+    bool contains(int key)
+    {
+        return shards[shard_of(key)]->contains(key);
+    }
 
-    //Дополнительные методы с базовыми математическими операциями:
-    int findMax(int operand_1, int operand_2)
+    template <class Func> bool update(int key, Func change)
     {
-        return (operand_1 >= operand_2) ? operand_1 : operand_2;
+        int shard = shard_of(key);
+        return shards[shard]->update(key, change);
     }
 
-    void swap(Node* node_1, Node* node_2)
+    template <class Value> bool upsert(int key, Value&& fn_or_data)
     {
-        int node_1_key = node_1->key();
-        T node_1_value = node_1->data();
+        int shard = shard_of(key);
+        raise_next_key(shard, key);
 
-        node_1->set_key(node_2->key());
-        node_2->set_key(node_1_key);
+        return shards[shard]->upsert(key, std::forward<Value>(fn_or_data));
+    }
+
+    template <class... Args> bool emplace(int key, Args&&... args)
+    {
+        int shard = shard_of(key);
+        raise_next_key(shard, key);
 
-        node_1->set_data(new T(node_2->data()));
-        node_2->set_data(&node_1_value);
+        return shards[shard]->emplace(key, std::forward<Args>(args)...);
     }
 
-    int calcNodeHeight(Node* node)
+    //Pins only the shard of the key:
+    auto access(int key)
     {
-        return (node == null) ? -1 : node->height_;
+        return shards[shard_of(key)]->access(key);
     }
 
-    void updateHeight(Node* node)
+    std::optional<T> find(int key)
     {
-        node->height_ = findMax(calcNodeHeight(node->get_left()), calcNodeHeight(node->get_right())) + 1;
+        return shards[shard_of(key)]->find(key);
     }
 
-    int calcBalanceValue(Node* node)
+    bool try_get(int key, T& out)
     {
-        return (node == null) ? 0 : calcNodeHeight(node->get_right()) - calcNodeHeight(node->get_left());
+        return shards[shard_of(key)]->try_get(key, out);
     }
 
+    T get_or(int key, T default_data)
+    {
+        return shards[shard_of(key)]->get_or(key, default_data);
+    }
 
-    void rightRotate(Node* node)
+    void remove(int key)
     {
-        swap(node, node->get_left());
+        shards[shard_of(key)]->remove(key);
+    }
 
-        Node* buffer = node->get_right();
-        node->set_right(node->get_left());
+    int size()
+    {
+        int size = 0;
+        for(auto& shard : shards)
+            size += shard->size();
 
-        node->set_left(node->get_right()->get_left());
+        return size;
+    }
 
-        node->get_right()->set_left(node->get_right()->get_right());
-        node->get_right()->set_right(buffer);
+    //Every shard must be valid and hold only the keys of its own residue
+    bool validate()
+    {
+        for(size_t i = 0; i < shards.size(); i++)
+        {
+            bool ownKeys = true;
+            shards[i]->forEach([this, i, &ownKeys](int key, const T&) { ownKeys = ownKeys && shard_of(key) == int(i); });
 
-        updateHeight(node->get_right());
-        updateHeight(node);
+            if(!ownKeys || !shards[i]->validate()) return false;
+        }
+
+        return true;
     }
 
-    void leftRotate(Node* node)
+    int shardCount()
     {
-        swap(node, node->get_right());
+        return int(shards.size());
+    }
 
-        Node* buf_1 = node->get_left();
-        node->set_left(node->get_right());
+    template <class Func> void forEach(Func visit)
+    {
+        std::vector<std::vector<std::pair<int, T>>> runs(shards.size());
+        for(size_t i = 0; i < shards.size(); i++)
+            shards[i]->forEach([&runs, i](int key, const T& data) { runs[i].emplace_back(key, data); });
 
-        node->set_right(node->get_left()->get_right());
+        typedef std::pair<int, size_t> Head; //The smallest unvisited key of a shard and the shard's number
+        std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+        std::vector<size_t> positions(runs.size(), 0);
 
-        node->get_left()->set_right(node->get_left()->get_left());
-        node->get_left()->set_left(buf_1);
+        for(size_t i = 0; i < runs.size(); i++)
+            if(!runs[i].empty()) heads.push(Head(runs[i][0].first, i));
 
-        updateHeight(node->get_left());
-        updateHeight(node);
+        while(!heads.empty())
+        {
+            size_t run = heads.top().second;
+            heads.pop();
+
+            std::pair<int, T>& item = runs[run][positions[run]++];
+            visit(item.first, item.second);
+
+            if(positions[run] < runs[run].size())
+                heads.push(Head(runs[run][positions[run]].first, run));
+        }
     }
 
-    void balance(Node* node)
+    void printTree()
     {
-        int balance = calcBalanceValue(node);
+        forEach([](int key, const T& data) { std::cout << "Node's key: " << key << "  -  Node's value: " << data << std::endl; });
+    }
 
-        if(balance == -2)
-        {
-            if(calcBalanceValue(node->get_left()) == 1)
-                leftRotate(node->get_left());
-            rightRotate(node);
-        }
-        else if(balance == 2)
+    void deleteTree()
+    {
+        for(size_t i = 0; i < shards.size(); i++)
         {
-            if(calcBalanceValue(node->get_right()) == -1)
-                rightRotate(node->get_right());
-            leftRotate(node);
+            shards[i]->deleteTree();
+            nextKeys[i].store(first_key(int(i)), std::memory_order_relaxed);
         }
     }
-
 };
-template <typename T> typename BinaryABLTree<T>::Node* BinaryABLTree<T>::null = nullptr;
 
-template <typename T> class BinaryRedBlackTree
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * *  Replicated tree for read-mostly work on NUMA hosts:    * *
+ * *    - every NUMA node has a replica of the whole tree,   * *
+ * *      and the changes are applied to it under            * *
+ * *      Numa::Placement of its node, so with               * *
+ * *      Values::NumaLocal its nodes live on that node      * *
+ * *    - the writers append their operations to one shared  * *
+ * *      log; a replica replays the log up to its end       * *
+ * *      before it is read or written through, so a reader  * *
+ * *      sees every write which returned before it started  * *
+ * *    - a thread reads only the replica of its own node,   * *
+ * *      and a lookup never touches the other sockets; the  * *
+ * *      lookup on an up-to-date replica doesn't lock the   * *
+ * *      log either, and shares the replica with the other  * *
+ * *      readers; so Tree must not change on a lookup (no   * *
+ * *      BinarySplayTree)                                   * *
+ * *  The price is the memory of N trees and every write     * *
+ * *  replayed N times; the writers trim the log to the      * *
+ * *  operations which some replica has not applied yet, and * *
+ * *  replay it themselves for a replica which fell maxLag   * *
+ * *  operations behind, so an idle node doesn't keep the    * *
+ * *  log growing                                            * *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+   * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+template <typename T, class Tree = BinaryTrees::BinaryRedBlackTree<T, Augmentation::None, Deletion::Immediate, Values::NumaLocal<>>> class BinaryTrees_Replicated
 {
-protected:
-    class Node
+    struct Operation
     {
-        bool color_mutable_;
-        bool key_mutable_;
-        bool data_mutable_;
-        bool relatives_mutable_;
+        enum Kind { Insert, Upsert, Remove, Clear } kind;
+        int key;
+        std::optional<T> data;
+    };
 
-        int key_;
-        T* data_;
-        COLOR color_ = RED;
+    struct Replica
+    {
+        std::shared_mutex mtx; //Shared by the readers of an up-to-date tree, exclusive while the log is replayed
+        BinaryTrees_API<T, Tree> tree;
+        std::atomic<size_t> applied{0}; //Position in the log up to which the tree is updated
+        int node = 0;
+    };
 
-        Node* root_ = nullptr;
-        Node* left_ = nullptr;
-        Node* right_ = nullptr;
-        Node* parent_ = nullptr;
+    static constexpr size_t maxLag = 1024;
 
+    std::vector<std::unique_ptr<Replica>> replicas;
 
-    public:
-        Node() = delete;
-        explicit Node(int key, T* data, COLOR color = RED, bool color_mutable = true, bool key_mutable = true, bool data_mutable = true, bool rel_mutable = true):
-            key_(key),
-            data_(new T(*data)), color_(color),
-            left_(null), right_(null), parent_(null),
-            color_mutable_(color_mutable), key_mutable_(key_mutable),
-            data_mutable_(data_mutable), relatives_mutable_(rel_mutable)
-        {
-            root_ = this;
-        }
+    std::mutex logMutex;
+    std::deque<Operation> log;
+    size_t logBase = 0; //Position of the first operation of the log
+    std::atomic<size_t> tail{0}; //Position after the last operation of the log, so an up-to-date replica is read without logMutex
+    int nextKey = 1;
 
 
-        void update(const T data)
-        {
-            *data_ = data;
-        }
+    Replica& local()
+    {
+        return *replicas[size_t(Numa::currentNode()) % replicas.size()];
+    }
 
-        T& operator = (const T data)
-        {
-            *data_ = data;
-        }
+    //Returns the position of the operation in the log:
+    size_t publish(Operation operation)
+    {
+        std::lock_guard<std::mutex> guard(logMutex);
+
+        if(operation.kind == Operation::Clear) nextKey = 1;
+        else if(operation.kind != Operation::Remove && operation.key >= nextKey) nextKey = operation.key + 1;
+
+        return push(std::move(operation));
+    }
+
+    //The key is taken under the lock of the log, so no insert() published before can hold it:
+    size_t publish_append(T& data, int& key)
+    {
+        std::lock_guard<std::mutex> guard(logMutex);
+
+        key = nextKey++;
+        return push(Operation{Operation::Insert, key, std::move(data)});
+    }
+
+    //Under logMutex; only the writers trim the log, so a reader takes logMutex once per catch-up at most:
+    size_t push(Operation&& operation)
+    {
+        size_t oldest = SIZE_MAX;
+        for(auto& replica : replicas)
+            oldest = std::min(oldest, replica->applied.load(std::memory_order_acquire));
+        for(; logBase < oldest; logBase++)
+            log.pop_front();
 
+        log.push_back(std::move(operation));
+        tail.store(logBase + log.size(), std::memory_order_release);
 
-        //Setters:
-        void set_color(COLOR cur_color)
-        {
-            if(color_mutable_)
-                color_ = cur_color;
-            // else std::cout << "Color is immutable, don't change it!\n";
-        }
-        void set_key(int cur_key)
-        {
-            if(key_mutable_)
-                key_ = cur_key;
-            // else std::cout << "Key is immutable, don't change it!\n";
-        }
-        void set_data(T* data)
-        {
-            if(data_mutable_)
-                *data_ = *data;
-            // else std::cout << "Data is immutable, don't change it!\n";
-        }
-        void set_root(Node* cur_root)
-        {
-            if(relatives_mutable_)
-                root_ = cur_root;
-            // else std::cout << "Root is immutable, don't change it!\n";
-        }
-        void set_left(Node* cur_left)
+        return logBase + log.size() - 1;
+    }
+
+    static bool apply(BinaryTrees_API<T, Tree>& tree, const Operation& operation)
+    {
+        switch(operation.kind)
         {
-            if(relatives_mutable_)
-                left_ = cur_left;
-            // else std::cout << "Left relative is immutable, don't change it!\n";
-        }
-        void set_right(Node* cur_right)
+        case Operation::Insert:
+            return tree.insert(operation.key, *operation.data);
+        case Operation::Upsert:
+            return tree.upsert(operation.key, *operation.data);
+        case Operation::Remove:
         {
-            if(relatives_mutable_)
-                right_ = cur_right;
-            // else std::cout << "Right relative is immutable, don't change it!\n";
+            bool found = tree.contains(operation.key);
+            if(found) tree.remove(operation.key);
+            return found;
         }
-        void set_parent(Node* cur_parent)
-        {
-            if(relatives_mutable_)
-                parent_ = cur_parent;
-            // else std::cout << "Parent is immutable, don't change it!\n";
+        case Operation::Clear:
+            tree.deleteTree();
+            return true;
         }
+        return false;
+    }
 
-        //Getters:
-        int key()
-        {
-            return key_;
-        }
-        const T data()
+    //Under the lock of the replica: replays the log up to its end, returns the result of the operation at the position wanted
+    bool catch_up(Replica& replica, size_t wanted = SIZE_MAX)
+    {
+        std::vector<Operation> pending;
+        size_t position = replica.applied.load(std::memory_order_relaxed);
+        if(position == tail.load(std::memory_order_acquire))
+            return false;
         {
-            return* data_;
+            std::lock_guard<std::mutex> guard(logMutex);
+            pending.assign(log.begin() + std::ptrdiff_t(position - logBase), log.end());
         }
 
-        COLOR color()
-        {
-            return color_;
-        }
-        Node* get_root()
-        {
-            return root_;
-        }
-        Node* get_left()
+        Numa::Placement placement(replica.node);
+
+        bool result = false;
+        for(const Operation& operation : pending)
         {
-            return left_;
+            bool applied = apply(replica.tree, operation);
+            if(position++ == wanted) result = applied;
         }
-        Node* get_right()
+        replica.applied.store(position, std::memory_order_release);
+
+        return result;
+    }
+
+    //Publishes the operation and replays the log up to it on the local replica, returns the result of the operation there:
+    bool write_local(Operation operation)
+    {
+        Replica& replica = local();
+        std::lock_guard<std::shared_mutex> guard(replica.mtx);
+
+        bool result = catch_up(replica, publish(std::move(operation)));
+        advance_idle(replica);
+
+        return result;
+    }
+
+    //A replica nobody reads would hold the log back forever; one which is busy catches up by itself, so it is skipped:
+    void advance_idle(Replica& own)
+    {
+        size_t end = tail.load(std::memory_order_acquire);
+        for(auto& replica : replicas)
         {
-            return right_;
+            if(replica.get() == &own || end - replica->applied.load(std::memory_order_acquire) <= maxLag) continue;
+
+            std::unique_lock<std::shared_mutex> lock(replica->mtx, std::try_to_lock);
+            if(lock.owns_lock())
+                catch_up(*replica);
         }
-        Node* get_parent()
+    }
+
+    //Runs read(tree) on the local replica, brought up to date first:
+    template <class Func> auto read_local(Func read)
+    {
+        Replica& replica = local();
         {
-            return parent_;
+            std::shared_lock<std::shared_mutex> shared(replica.mtx);
+            if(replica.applied.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire))
+                return read(replica.tree);
         }
 
+        std::lock_guard<std::shared_mutex> guard(replica.mtx);
+        catch_up(replica);
+        return read(replica.tree);
+    }
 
-    protected:
-        template <typename U = T>
-        void operator delete(void* ptr, U); //! Либо вместо U использовать - typename std::enable_if<!std::is_same<U, BinarySearchTree>::value>::type* = nullptr - это механизм позволяющий контролировать, что объекту, который захочет удалить Node, разрешено это делать - на самом деле не работает в данном случае, так что это просто как вариант действий
 
-        static void destroy(Node* node)
+public:
+    //One replica per NUMA node by default:
+    explicit BinaryTrees_Replicated(int count = Numa::nodeCount())
+    {
+        for(int i = 0; i < (count > 0 ? count : 1); i++)
         {
-            node->~Node();
-            free(node);
+            replicas.emplace_back(new Replica());
+            replicas.back()->node = i % Numa::maxNodes;
         }
+    }
 
-        friend class BinaryRedBlackTree;
-    };
-    static Node *null;
+    int append(T data)
+    {
+        Replica& replica = local();
+        std::lock_guard<std::shared_mutex> guard(replica.mtx);
 
+        int key;
+        catch_up(replica, publish_append(data, key));
+        advance_idle(replica);
 
-    Node *search(Node* node, int key)
+        return key;
+    }
+
+    bool insert(int key, T data)
     {
-        if(node == null) return null;
-        if(node->key() == key) return node;
+        return write_local(Operation{Operation::Insert, key, std::move(data)});
+    }
 
-        return (key < node->key()) ? search(node->get_left(), key) : search(node->get_right(), key);
+    bool upsert(int key, T data)
+    {
+        return write_local(Operation{Operation::Upsert, key, std::move(data)});
     }
 
-    Node *getMin(Node* node)
+    //True if the node was there:
+    bool remove(int key)
     {
-        if(node->get_left() == null) return node;
-        return getMin(node->get_left());
+        return write_local(Operation{Operation::Remove, key, std::nullopt});
     }
 
-    Node *getMax(Node* node)
+    std::optional<T> find(int key)
     {
-        if(node->get_right() == null) return node;
-        return getMax(node->get_right());
+        return read_local([key](BinaryTrees_API<T, Tree>& tree) { return tree.find(key); });
     }
 
-    void insert(Node* __restrict node, int key, T* __restrict data)
+    bool contains(int key)
     {
-        insert_process(node, key, data);
+        return read_local([key](BinaryTrees_API<T, Tree>& tree) { return tree.contains(key); });
     }
 
-    void remove(Node*& node, int key)
+    T get_or(int key, T default_data)
     {
-        remove_process(node, key);
+        return read_local([key, &default_data](BinaryTrees_API<T, Tree>& tree) { return tree.get_or(key, std::move(default_data)); });
     }
 
+    int size()
+    {
+        return read_local([](BinaryTrees_API<T, Tree>& tree) { return tree.size(); });
+    }
 
-    void printTree(Node* node)
+    template <class Func> void forEach(Func visit)
     {
-        if(node == nullptr || node == null) { return;}
-        printTree(node->get_right());
-        printTree(node->get_left());
-        std::cout << "Node's key: " << node->key() << "  -  Node's color: " << node->color() << "  -  Node's value: " << node->data() << "  -  Node's adress: " << node << "  -  Root adress: " << node->get_root() << std::endl;
+        read_local([&visit](BinaryTrees_API<T, Tree>& tree) { tree.forEach(visit); });
     }
 
-    void deleteTree(Node*& node)
+    void printTree()
     {
-        if(node == nullptr || node == null) return;
+        read_local([](BinaryTrees_API<T, Tree>& tree) { tree.printTree(); });
+    }
 
-        Node* delLeft = node->get_left();
-        Node* delRight = node->get_right();
-        deleteTree(delLeft);
-        deleteTree(delRight);
+    //Every replica must be valid and, once up to date, hold the same keys - while no writers run
+    bool validate()
+    {
+        std::vector<int> first;
+        for(size_t i = 0; i < replicas.size(); i++)
+        {
+            std::lock_guard<std::shared_mutex> guard(replicas[i]->mtx);
+            catch_up(*replicas[i]);
 
-        Node::destroy(node);
-        node = nullptr;
+            std::vector<int> keys;
+            replicas[i]->tree.forEach([&keys](int key, const T&) { keys.push_back(key); });
+
+            if(!replicas[i]->tree.validate() || (i > 0 && keys != first)) return false;
+            if(i == 0) first.swap(keys);
+        }
+
+        return true;
     }
 
-    void copyTree(Node* node_donor, Node* node_recipient)
+    int replicaCount()
     {
-        if(node_donor == null) return;
-        copyTree(node_donor->get_right(), node_recipient->get_right());
-        copyTree(node_donor->get_left(), node_recipient->get_left());
-        node_recipient->set_key(node_donor->key());
-        node_recipient->set_data(node_donor->data());
+        return int(replicas.size());
     }
 
-    int getSizeTree(Node* node)
+    void deleteTree()
     {
-        int countNodes = 0;
-        checkSizeTree_process(node, &countNodes);
-
-        return countNodes;
+        write_local(Operation{Operation::Clear, 0, std::nullopt});
     }
+};
 
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * *  Access to trees with string keys (URLs, paths...):     * *
+ * *    - the same calls as BinaryTrees_API, with            * *
+ * *      std::string in place of the int key                * *
+ * *    - forEach() visits the keys in the order of          * *
+ * *      std::string; forEachPrefix() - only the keys which * *
+ * *      start with the prefix, forEachRange() - only the   * *
+ * *      keys in [low, high); both go down to the first     * *
+ * *      key without visiting the rest of the tree          * *
+ * *  visit(const std::string& key, const T& data)           * *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+   * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+template <typename T, class Tree = BinaryTrees::BinaryRadixTree<T>, class Mutex = ThreadingModel::SingleThreaded> class BinaryTrees_Strings: public Tree, Mutex
+{
+    typename Tree::Node *tree = Tree::null;
+    int count = 0;
 
-private:
-    void balance(Node* tree, Node*& newNode)
+
+public:
+    explicit BinaryTrees_Strings()
     {
-        Node* uncle;
 
-        if(newNode->get_parent()->get_parent() != null)
-        {
-            while((newNode != tree->get_root()) && (newNode->get_parent()->color() == RED))
-            {
-                if(newNode->get_parent() == newNode->get_parent()->get_parent()->get_left())
-                {
-                    uncle = newNode->get_parent()->get_parent()->get_right();
+    }
+    ~BinaryTrees_Strings()
+    {
+        deleteTree();
+    }
 
-                    if(uncle->color() == RED)
-                    {
-                        newNode->get_parent()->set_color(BLACK);
-                        uncle->set_color(BLACK);
-                        newNode->get_parent()->get_parent()->set_color(RED);
-                        newNode = newNode->get_parent()->get_parent();
-                    }
-                    else
-                    {
-                        if(newNode == newNode->get_parent()->get_right())
-                        {
-                            leftRotate(newNode->get_parent());
-                        }
+    //Returns false (and keeps the old data) if the key is already there:
+    bool insert(const std::string& key, T data)
+    {
+        ThreadSafe_ON
 
-                        newNode->get_parent()->set_color(RED);
-                        rightRotate(newNode->get_parent()->get_parent());
+        bool inserted = Tree::insert(tree, key, &data);
+        if(inserted) count++;
 
-                        newNode = newNode->get_parent();
-                    }
-                }
-                else
-                {
-                    uncle = newNode->get_parent()->get_parent()->get_left();
+        ThreadSafe_OFF
 
-                    if(uncle->color() == RED)
-                    {
-                        newNode->get_parent()->set_color(BLACK);
-                        uncle->set_color(BLACK);
-                        newNode->get_parent()->get_parent()->set_color(RED);
-                        newNode = newNode->get_parent()->get_parent();
-                    }
-                    else
-                    {
-                        if(newNode == newNode->get_parent()->get_left())
-                        {
-                            rightRotate(newNode->get_parent());
-                        }
+        return inserted;
+    }
 
-                        newNode->get_parent()->set_color(RED);
-                        leftRotate(newNode->get_parent()->get_parent());
+    //update(key, change) applies change(T& data) to the stored payload, upsert() inserts the key if it is missing:
+    template <class Func> bool update(const std::string& key, Func change)
+    {
+        ThreadSafe_ON
 
-                        newNode = newNode->get_parent();
-                    }
-                }
-            }
-        }
+        typename Tree::Node* node = Tree::search(tree, key);
+        if(node != Tree::null)
+            Tree::modify(tree, node, change);
+
+        ThreadSafe_OFF
 
-        tree->get_root()->set_color(BLACK);
+        return node != Tree::null;
     }
 
-    void insert_process(Node* __restrict node, int key, T* __restrict data)
+    template <class Func, typename = typename std::enable_if<std::is_invocable<Func&, T&>::value>::type> bool upsert(const std::string& key, Func change)
     {
-        Node* currentNode = node->get_root();
-        Node* parent = null;
+        ThreadSafe_ON
 
-        while(node_exists(currentNode))
+        typename Tree::Node* node = Tree::search(tree, key);
+        if(node != Tree::null)
+            Tree::modify(tree, node, change);
+        else
         {
-            parent = currentNode;
-            if(key < currentNode->key())
-                currentNode = currentNode->get_left();
-            else
-                currentNode = currentNode->get_right();
+            T data = T();
+            change(data);
+            Tree::insert(tree, key, &data);
+            count++;
         }
 
+        ThreadSafe_OFF
 
-        Node* newNode = create_node(key, data, RED, parent);
-
-        if(key < parent->key())
-            parent->set_left(newNode);
-        else
-            parent->set_right(newNode);
-        newNode->set_root(parent->get_root());
+        return node == Tree::null;
+    }
 
-        balance(node, newNode);
+    bool upsert(const std::string& key, T data)
+    {
+        return upsert(key, [&data](T& payload) { payload = std::move(data); });
     }
 
-    void balance(Node* tree, Node* child, Node* parent)
+    typename Tree::Node *search(const std::string& key)
     {
-        while(child != tree->get_root() && child->color() == BLACK)
+        ThreadSafe_ON
+
+        typename Tree::Node* node = Tree::search(tree, key);
+        if(node == Tree::null)
         {
-            Node* brother;
+            ThreadSafe_OFF
+            throw std::out_of_range("Out of range! Node not found in the three...");
+        }
 
-            if(child == parent->get_left())
-            {
-                brother = parent->get_right();
-                if(brother->color() == RED)
-                {
-                    brother->set_color(BLACK);
-                    parent->set_color(RED);
-                    leftRotate(parent);
-                    brother = parent->get_right();
-                }
-                if((!brother->get_left() || brother->get_left()->color() == BLACK) && (!brother->get_right() || brother->get_right()->color() == BLACK))
-                {
-                    brother->set_color(RED);
-                    child = parent;
-                    parent = child->get_parent();
-                }
-                else
-                {
-                    if(!(brother->get_right()) || brother->get_right()->color() == BLACK)
-                    {
-                        brother->get_left()->set_color(BLACK);
-                        brother->set_color(RED);
-                        rightRotate(brother);
-                    }
+        ThreadSafe_OFF
 
-                    brother->set_color(parent->color());
-                    parent->set_color(BLACK);
-                    brother->get_right()->set_color(BLACK);
-                    leftRotate(parent);
+        return node;
+    }
 
-                    brother = parent->get_right();
-                    child = tree->get_root();
-                }
-            }
-            else
-            {
-                brother = parent->get_left();
-                if(brother->color() == RED)
-                {
-                    brother->set_color(BLACK);
-                    parent->set_color(RED);
-                    rightRotate(parent);
-                    brother = parent->get_left();
-                }
-                if((!brother->get_left() || brother->get_left()->color() == BLACK) && (!brother->get_right() || brother->get_right()->color() == BLACK))
-                {
-                    brother->set_color(RED);
-                    child = parent;
-                    parent = child->get_parent();
-                }
-                else
-                {
-                    if(!(brother->get_left()) || brother->get_left()->color() == BLACK)
-                    {
-                        brother->get_right()->set_color(BLACK);
-                        brother->set_color(RED);
-                        leftRotate(brother);
-                        brother = parent->get_left();
-                    }
+    bool contains(const std::string& key)
+    {
+        ThreadSafe_ON
 
-                    brother->set_color(parent->color());
-                    parent->set_color(BLACK);
-                    brother->get_left()->set_color(BLACK);
-                    rightRotate(parent);
+        bool found = (Tree::search(tree, key) != Tree::null);
 
-                    child = tree->get_root();
-                }
-            }
-        }
+        ThreadSafe_OFF
 
-        if(child->get_left()->color() == RED || child->get_right()->color() == RED)
-            child->set_color(BLACK);
+        return found;
     }
 
-    void remove_process(Node*& node, int key)
+    std::optional<T> find(const std::string& key)
     {
-        Node* nodeToDelete = search(node->get_root(), key);
-        bool removedNodeColor = nodeToDelete->color();
-        Node* parent = nodeToDelete->get_parent();
-        Node* child;
+        ThreadSafe_ON
 
-        if(getChildrenCount(nodeToDelete) < 2)
-        {
-            child = getChildOrMock(nodeToDelete);
-            transplainNode(node, nodeToDelete, child);
-        }
-        else
-        {
-            Node* minNode = getMin(nodeToDelete->get_right());
+        typename Tree::Node* node = Tree::search(tree, key);
+        std::optional<T> data = (node == Tree::null) ? std::nullopt : std::optional<T>(node->data());
+
+        ThreadSafe_OFF
 
-            parent = minNode->get_parent();
-            removedNodeColor = minNode->color();
+        return data;
+    }
 
-            nodeToDelete->set_key(minNode->key());
-            nodeToDelete->set_data(new T(minNode->data()));
+    bool try_get(const std::string& key, T& out)
+    {
+        ThreadSafe_ON
 
-            child = getChildOrMock(minNode);
-            transplainNode(node, minNode, child);
-        }
+        typename Tree::Node* node = Tree::search(tree, key);
+        bool found = (node != Tree::null);
+        if(found)
+            out = node->data();
 
+        ThreadSafe_OFF
 
-        if(removedNodeColor == BLACK)
-            balance(node, child, parent);
+        return found;
     }
 
-    void checkSizeTree_process(Node* node, int* count)
+    T get_or(const std::string& key, T default_data)
     {
-        if(node == nullptr || node == null) return;
-        checkSizeTree_process(node->get_left(), count);
-        *count += 1;
-        checkSizeTree_process(node->get_right(), count);
-    }
+        ThreadSafe_ON
 
+        typename Tree::Node* node = Tree::search(tree, key);
+        if(node != Tree::null)
+            default_data = node->data();
 
-    bool node_exists(Node *node)
-    {
-        return node != null;
+        ThreadSafe_OFF
+
+        return default_data;
     }
 
-    Node *create_node(int key, T* __restrict data, COLOR color, Node* __restrict parent)
+    template <class Func> void forEach(Func visit)
     {
-        Node* newNode = new Node(key, data, color);
-        newNode->set_parent(parent);
+        ThreadSafe_ON
 
-        return newNode;
+        auto visitNode = [&visit](const std::string& key, typename Tree::Node* node) { visit(key, node->data()); };
+        Tree::traverseTree(tree, visitNode);
+
+        ThreadSafe_OFF
     }
 
-    void swap(Node* node_1, Node* node_2)
+    template <class Func> void forEachPrefix(const std::string& prefix, Func visit)
     {
-        int node_1_key = node_1->key();
-        T node_1_value = node_1->data();
+        ThreadSafe_ON
 
-        node_1->set_key(node_2->key());
-        node_2->set_key(node_1_key);
+        auto visitNode = [&visit](const std::string& key, typename Tree::Node* node) { visit(key, node->data()); };
+        Tree::traversePrefix(tree, prefix, visitNode);
 
-        node_1->set_data(new T(node_2->data()));
-        node_2->set_data(&node_1_value);
+        ThreadSafe_OFF
     }
 
-    int getChildrenCount(Node* node)
+    template <class Func> void forEachRange(const std::string& low, const std::string& high, Func visit)
     {
-        int count = 0;
-        if(node_exists(node->get_left()))
-            count += 1;
-        if(node_exists(node->get_right()))
-            count += 1;
+        ThreadSafe_ON
 
-        return count;
-    }
+        auto visitNode = [&visit](const std::string& key, typename Tree::Node* node) { visit(key, node->data()); };
+        Tree::traverseRange(tree, low, high, visitNode);
 
-    Node* getChildOrMock(Node* node)
-    {
-        return node_exists(node->get_left()) ? node->get_left() : node->get_right();
+        ThreadSafe_OFF
     }
 
-    void fixRoot(Node* tree, Node* node)
+    int size()
     {
-        if(node == null) return;
+        ThreadSafe_ON
 
-        fixRoot(tree, node->get_left());
-        node->set_root(tree->get_root());
-        fixRoot(tree, node->get_right());
+        int size = count;
+
+        ThreadSafe_OFF
+
+        return size;
     }
 
-    void transplainNode(Node*& tree, Node*& toNode, Node* fromNode)
+    //Checks the invariants of the backend and the count of the keys - in linear time, for debugging and stress runs
+    bool validate()
     {
-        if(toNode == tree->get_root())
-        {
-            tree = fromNode;
-            tree->set_root(fromNode);
-            fixRoot(tree, tree);
-        }
-        else if(toNode == toNode->get_parent()->get_left())
-            toNode->get_parent()->set_left(fromNode);
-        else
-            toNode->get_parent()->set_right(fromNode);
+        ThreadSafe_ON
 
+        bool valid = Tree::validate(tree) && count == Tree::getSizeTree(tree);
 
-        if(fromNode != null)
-        {
-            fromNode->set_parent(toNode->get_parent());
-            Node::destroy(toNode);
-        }
+        ThreadSafe_OFF
+
+        return valid;
     }
 
-    void rightRotate(Node* node)
+    void printTree()
     {
-        swap(node, node->get_left());
-
-        Node* buffer = node->get_right();
-        node->set_right(node->get_left());
+        ThreadSafe_ON
 
-        node->set_left(node->get_right()->get_left());
-        node->get_left()->set_parent(node);
+        Tree::printTree(tree);
 
-        node->get_right()->set_left(node->get_right()->get_right());
-        node->get_right()->set_right(buffer);
-        node->get_right()->get_right()->set_parent(node->get_right());
+        ThreadSafe_OFF
     }
 
-    void leftRotate(Node* node)
+    //Returns false if there was no such key:
+    bool remove(const std::string& key)
     {
-        swap(node, node->get_right());
+        ThreadSafe_ON
 
-        Node* buffer = node->get_left();
-        node->set_left(node->get_right());
+        bool removed = Tree::remove(tree, key);
+        if(removed) count--;
 
-        node->set_right(node->get_left()->get_right());
-        node->get_right()->set_parent(node);
+        ThreadSafe_OFF
 
-        node->get_left()->set_right(node->get_left()->get_left());
-        node->get_left()->set_left(buffer);
-        node->get_left()->get_left()->set_parent(node->get_left());
+        return removed;
     }
+    void deleteTree()
+    {
+        ThreadSafe_ON
 
+        Tree::deleteTree(tree);
+        tree = Tree::null;
+        count = 0;
 
-    static Node NullNode;
+        ThreadSafe_OFF
+    }
 };
-template <typename T> typename BinaryRedBlackTree<T>::Node BinaryRedBlackTree<T>::NullNode(0, new T(), BLACK, IMMUTTABLE, IMMUTTABLE, IMMUTTABLE, IMMUTTABLE); //Для каждого типа, который будет использован в процессе работы программы(те с которым вызвана в коде данная библиотека), будет создана своя статическая переменная NullNode
-template <typename T> typename BinaryRedBlackTree<T>::Node* BinaryRedBlackTree<T>::null = &NullNode;
-
 
-/* * * * * * * * * * * * * * * * *
- * * * * * * * * * * * * * * * * * *
- * *       Access to trees       * *
- * * * * * * * * * * * * * * * * * *
-   * * * * * * * * * * * * * * * * */
-template <typename T, class Tree = BinaryTrees::BinarySearchTree<T>, class Mutex = ThreadingModel::SingleThreaded>  class BinaryTrees_API: public Tree, Mutex
+#ifdef BINARY_TREES_DURABLE
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * *  Durable tree (POSIX): every insert, append and remove  * *
+ * *  is written to <path>.log before the call returns:      * *
+ * *    - group commit: the writers which come while one     * *
+ * *      fdatasync() is running are flushed together by the * *
+ * *      next one, so one fsync serves many writers         * *
+ * *    - checkpoint() writes the whole tree to              * *
+ * *      <path>.snapshot (through a temporary file and      * *
+ * *      rename) and starts the log anew; with              * *
+ * *      checkpointEvery > 0 it is done after so many logged * *
+ * *      operations                                         * *
+ * *    - a failed write or fdatasync() throws to every      * *
+ * *      writer of the batch; the log is cut back to its    * *
+ * *      last complete batch, and the failed records are    * *
+ * *      written again by the next flush                    * *
+ * *    - the constructor recovers the tree: the snapshot,   * *
+ * *      then the log up to its last complete record        * *
+ * *  The data is written as raw bytes, so T must be         * *
+ * *  trivially copyable                                     * *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+   * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+template <typename T, class Tree = BinaryTrees::BinaryRedBlackTree<T>, class Mutex = ThreadingModel::ObjectLevelLockable> class BinaryTrees_Durable
 {
-#define ThreadSafe_ON Mutex::lock();
-#define ThreadSafe_OFF Mutex::unlock();
-
-    typename Tree::Node *tree = Tree::null;
+    static_assert(std::is_trivially_copyable<T>::value, "The log keeps the data as raw bytes");
+
+    enum Operation : uint8_t { Insert = 1, Remove = 2 };
+    static constexpr size_t recordSize = 1 + sizeof(int) + sizeof(T) + sizeof(uint32_t); //operation, key, data, checksum
+    static constexpr char snapshotMagic[4] = {'A', 'B', 'T', 'S'};
+
+    BinaryTrees_API<T, Tree, Mutex> tree;
+    std::string path;
+    int logFile = -1;
+    size_t checkpointEvery;
+    size_t logged = 0; //Operations in the log since the last checkpoint
+    int nextKey = 1; //Kept by the snapshot, so append() never gives out a key again after a checkpoint drops it
+
+    std::mutex logMutex; //Orders the changes of the tree and their records in the log
+    std::condition_variable flushed;
+    std::vector<char> pending; //Records which are not yet written
+    uint64_t lastSequence = 0; //The number of the last record given to the log
+    uint64_t durableSequence = 0; //All records up to this one are on the disk
+    uint64_t failedSequence = 0; //The writers of the records up to this one which are not on the disk get the error of their flush
+    std::exception_ptr failure;
+    off_t logEnd = 0; //The end of the last batch which was written completely
+    bool broken = false; //A failed batch could not be cut off the log, so no record may follow it until the next checkpoint
+    bool flushing = false;
+
+
+    static uint32_t checksum(const char* bytes, size_t size)
+    {
+        uint32_t hash = 2166136261u; //FNV-1a
+        for(size_t i = 0; i < size; i++)
+            hash = (hash ^ uint8_t(bytes[i])) * 16777619u;
 
+        return hash;
+    }
 
-    bool availability_key(int key)
+    //A created or renamed file is durable only once its directory is synced:
+    static void sync_directory(const std::string& file)
     {
-        if(Tree::search(tree, key) == Tree::null)
-            return true;
-        return false;
+        size_t slash = file.find_last_of('/');
+        std::string directory = (slash == std::string::npos) ? "." : (slash == 0 ? "/" : file.substr(0, slash));
+
+        int handle = ::open(directory.c_str(), O_RDONLY);
+        bool synced = (handle >= 0 && ::fsync(handle) == 0);
+        if(handle >= 0) ::close(handle);
+        if(!synced)
+            throw std::runtime_error("Can't sync the directory of the tree: " + directory + ": " + std::string(std::strerror(errno)));
     }
-    bool is_tree_empty()
+
+    static void write_all(int file, const char* bytes, size_t size)
     {
-        if(!Tree::getSizeTree(tree))
-            return true;
-        return false;
+        while(size > 0)
+        {
+            ssize_t written = ::write(file, bytes, size);
+            if(written < 0 && errno == EINTR)
+                continue;
+            if(written < 0)
+                throw std::runtime_error("Can't write the log of the tree: " + std::string(std::strerror(errno)));
+
+            bytes += written;
+            size -= size_t(written);
+        }
     }
 
+    //Under logMutex, right after the change of the tree:
+    uint64_t log(Operation operation, int key, const T& data)
+    {
+        char record[recordSize];
+        record[0] = char(operation);
+        std::memcpy(record + 1, &key, sizeof(int));
+        std::memcpy(record + 1 + sizeof(int), &data, sizeof(T));
+        uint32_t sum = checksum(record, recordSize - sizeof(uint32_t));
+        std::memcpy(record + recordSize - sizeof(uint32_t), &sum, sizeof(uint32_t));
 
-public:
-    /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
-     * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
-     * *  This container must ensure the following constraints:                                                      * *
-     * *    - the key of each node of the tree is unique!                                                            * *
-     * *    - new nodes can be added:                                                                                * *
-     * *        * by explicitly specifying the key                                                                   * *
-     * *          (in this case, the node may not be created if such a key already exists -                          * *
-     * *          the user will be notified of the success of the operation by boolean values                        * *
-     * *          returned from the corresponding function)                                                          * *
-     * *        * by passing only the data that should be stored in the tree                                         * *
-     * *          (then the key is assigned to such data automatically)                                              * *
-     * *    - nodes can be deleted only by the obtained key value, or all nodes of the tree can be deleted at once,  * *
-     * *      or the tree itself can be deleted!                                                                     * *
-     * *    - it is also possible to get the number of nodes in the tree                                             * *
-     * *    - it is possible to get any node in the tree                                                             * *
-     * *    - output to the console of all elements of the tree                                                      * *
-     * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
-       * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+        pending.insert(pending.end(), record, record + recordSize);
+        logged++;
 
-    /*
-    //Данный контейнер, должен обеспечивать гарантировать следующие ограничения:
-    // - ключ каждого узла дерева - уникален!
-    // - добавлять новые узлы можно:
-    //   * явно задавая ключ (в этом случае узел может быть не создан, если такой ключ уже есть - об успехе операции пользователь будет уведомлён булевыми значениями, возращенными из соответствующей функции)
-    //   * передавая лишь сами данные, которые должны быть сохранены в дереве (тогда ключ таким данным назначается автоматически)
-    // - удалять узлы можно лишь по полученному значению ключа, либо удалять все узлы дерева разом, либо удалять само дерево!
-    // - можно также получить количество узлов в дереве
-    // - можно получить любой узел в дереве
-    // - вывод в консоль всех элементов дерева
-    */
+        return ++lastSequence;
+    }
 
-    explicit BinaryTrees_API() = default;
-    explicit BinaryTrees_API(int key, T data)
+    //Returns when the record is on the disk; the first writer which finds nobody flushing flushes all pending records
+    void commit(std::unique_lock<std::mutex>& lock, uint64_t sequence)
     {
-        ThreadSafe_ON
+        while(durableSequence < sequence)
+        {
+            if(broken)
+                throw std::runtime_error("The log of the tree is damaged by a failed write, only checkpoint() can write it anew");
+            if(sequence <= failedSequence)
+                std::rethrow_exception(failure);
+            if(flushing)
+            {
+                flushed.wait(lock);
+                continue;
+            }
 
-        tree = new typename Tree::Node(key, &data); //По умолчанию, при создании данного дерева, узлов в нём нет, а потому любой ключ доступен, в отличии от добавления в уже созданый контейнер!
+            flushing = true;
+            std::vector<char> batch;
+            batch.swap(pending);
+            uint64_t batchSequence = lastSequence;
 
-        ThreadSafe_OFF
-    }
-    virtual ~BinaryTrees_API()
-    {
-        deleteTree();
+            lock.unlock();
+            try
+            {
+                write_all(logFile, batch.data(), batch.size());
+                if(::fdatasync(logFile) != 0)
+                    throw std::runtime_error("Can't sync the log of the tree: " + std::string(std::strerror(errno)));
+            }
+            catch(...)
+            {
+                //Nobody else writes while flushing is set, so the log is cut back to the end of the previous batch here:
+                bool restored = ::ftruncate(logFile, logEnd) == 0 && ::lseek(logFile, logEnd, SEEK_SET) == logEnd;
+
+                lock.lock();
+                batch.insert(batch.end(), pending.begin(), pending.end());
+                pending.swap(batch);
+                broken = broken || !restored;
+                failedSequence = batchSequence;
+                failure = std::current_exception();
+                flushing = false;
+                flushed.notify_all();
+                throw;
+            }
+            lock.lock();
+
+            flushing = false;
+            logEnd += off_t(batch.size());
+            durableSequence = batchSequence;
+            flushed.notify_all();
+        }
+
+        if(checkpointEvery > 0 && logged >= checkpointEvery)
+            checkpoint_process(lock);
     }
 
-    /* * * * * * * * * * * * * * * * * * * * * * * * * * *
-     * *      If the user does not specify the key       * *
-     * *        they need, then the key is found         * *
-     * *     automatically and the user should know      * *
-     * *  it, so the key is returned from the function!  * *
-       * * * * * * * * * * * * * * * * * * * * * * * * * * */
-    int append(T data)
+    void checkpoint_process(std::unique_lock<std::mutex>& lock)
     {
-        ThreadSafe_ON
-
-        int key = 1;
+        while(flushing)
+            flushed.wait(lock);
+
+        std::string temporary = path + ".snapshot.tmp";
+        int file = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if(file < 0)
+            throw std::runtime_error("Can't write the snapshot of the tree: " + std::string(std::strerror(errno)));
+
+        std::vector<char> snapshot(snapshotMagic, snapshotMagic + sizeof(snapshotMagic));
+        uint64_t count = uint64_t(tree.size());
+        snapshot.insert(snapshot.end(), reinterpret_cast<const char*>(&count), reinterpret_cast<const char*>(&count) + sizeof(count));
+        snapshot.insert(snapshot.end(), reinterpret_cast<const char*>(&nextKey), reinterpret_cast<const char*>(&nextKey) + sizeof(nextKey));
+        tree.forEach([&snapshot](int key, const T& data)
+        {
+            snapshot.insert(snapshot.end(), reinterpret_cast<const char*>(&key), reinterpret_cast<const char*>(&key) + sizeof(int));
+            snapshot.insert(snapshot.end(), reinterpret_cast<const char*>(&data), reinterpret_cast<const char*>(&data) + sizeof(T));
+        });
+        uint32_t sum = checksum(snapshot.data(), snapshot.size());
+        snapshot.insert(snapshot.end(), reinterpret_cast<const char*>(&sum), reinterpret_cast<const char*>(&sum) + sizeof(sum));
 
-        if(is_tree_empty())
-            tree = new typename Tree::Node(key, &data);
-        else
+        try
         {
-            typename Tree::Node *node = Tree::getMax(tree);
-            key += node->key();
-            Tree::insert(node, key, &data);
+            write_all(file, snapshot.data(), snapshot.size());
         }
-
-        ThreadSafe_OFF
-
-        return key;
+        catch(...)
+        {
+            ::close(file);
+            throw;
+        }
+        bool synced = (::fsync(file) == 0);
+        ::close(file);
+        if(!synced || std::rename(temporary.c_str(), (path + ".snapshot").c_str()) != 0)
+            throw std::runtime_error("Can't write the snapshot of the tree: " + std::string(std::strerror(errno)));
+        sync_directory(path + ".snapshot"); //Otherwise a power loss could undo the rename but keep the emptied log
+
+        //The snapshot holds everything the log had, including the records not written yet:
+        if(::ftruncate(logFile, 0) != 0 || ::lseek(logFile, 0, SEEK_SET) != 0 || ::fdatasync(logFile) != 0)
+            throw std::runtime_error("Can't truncate the log of the tree: " + std::string(std::strerror(errno)));
+
+        pending.clear();
+        durableSequence = lastSequence;
+        logEnd = 0;
+        broken = false;
+        logged = 0;
+        flushed.notify_all();
     }
 
-    /* * * * * * * * * * * * * * * * * * * * * * * * * * * * *
-     * *   If a node with the required key already exists,   * *
-     * *   the node insertion does not occur, and the user   * *
-     * *         is explicitly notified about it             * *
-       * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
-    bool insert(int key, T data)
+    void recover()
     {
-        ThreadSafe_ON
-
-        if(is_tree_empty())
-            tree = new typename Tree::Node(key, &data);
-        else
+        std::string snapshotPath = path + ".snapshot";
+        int file = ::open(snapshotPath.c_str(), O_RDONLY);
+        if(file >= 0)
         {
-            if(availability_key(key))
-                Tree::insert(tree, key, &data);
-            else
+            std::vector<char> snapshot = read_all(file);
+            ::close(file);
+
+            uint64_t count = 0;
+            size_t header = sizeof(snapshotMagic) + sizeof(count) + sizeof(nextKey);
+            if(snapshot.size() >= header)
+            {
+                std::memcpy(&count, snapshot.data() + sizeof(snapshotMagic), sizeof(count));
+                std::memcpy(&nextKey, snapshot.data() + sizeof(snapshotMagic) + sizeof(count), sizeof(nextKey));
+            }
+
+            size_t entry = sizeof(int) + sizeof(T);
+            uint32_t sum = 0;
+            bool whole = snapshot.size() >= header + sizeof(sum) && std::memcmp(snapshot.data(), snapshotMagic, sizeof(snapshotMagic)) == 0 &&
+                         (snapshot.size() - header - sizeof(sum)) / entry == count && (snapshot.size() - header - sizeof(sum)) % entry == 0;
+            if(whole)
+                std::memcpy(&sum, snapshot.data() + snapshot.size() - sizeof(sum), sizeof(sum));
+            if(!whole || sum != checksum(snapshot.data(), snapshot.size() - sizeof(sum)))
+                throw std::runtime_error("The snapshot of the tree is damaged: " + snapshotPath);
+
+            for(uint64_t i = 0; i < count; i++)
             {
-                ThreadSafe_OFF
-                return false;
+                int key;
+                T data;
+                std::memcpy(&key, snapshot.data() + header + i * entry, sizeof(int));
+                std::memcpy(&data, snapshot.data() + header + i * entry + sizeof(int), sizeof(T));
+                tree.insert(key, data);
             }
         }
 
-        ThreadSafe_OFF
+        std::vector<char> records = read_all(logFile);
+        size_t valid = 0;
+        for(; valid + recordSize <= records.size(); valid += recordSize)
+        {
+            const char* record = records.data() + valid;
+            uint32_t sum;
+            std::memcpy(&sum, record + recordSize - sizeof(uint32_t), sizeof(uint32_t));
+            if(sum != checksum(record, recordSize - sizeof(uint32_t))) break;
 
-        return true;
+            int key;
+            T data;
+            std::memcpy(&key, record + 1, sizeof(int));
+            std::memcpy(&data, record + 1 + sizeof(int), sizeof(T));
+
+            if(record[0] == Insert) tree.insert(key, data);
+            else if(record[0] == Remove) tree.remove(key);
+            else break;
+
+            if(record[0] == Insert && key >= nextKey)
+                nextKey = key + 1;
+
+            logged++;
+        }
+
+        //A torn record at the end was never acknowledged to its writer:
+        if(valid != records.size() && ::ftruncate(logFile, off_t(valid)) != 0)
+            throw std::runtime_error("Can't truncate the log of the tree: " + std::string(std::strerror(errno)));
+        logEnd = off_t(valid);
+        ::lseek(logFile, logEnd, SEEK_SET);
     }
 
-    typename Tree::Node *search(int key)
+    static std::vector<char> read_all(int file)
     {
-        ThreadSafe_ON
+        std::vector<char> bytes;
+        char buffer[1 << 16];
+        for(ssize_t count; (count = ::read(file, buffer, sizeof(buffer))) > 0; )
+            bytes.insert(bytes.end(), buffer, buffer + count);
 
-        typename Tree::Node* node = Tree::search(tree, key);
+        return bytes;
+    }
 
-        if(node == Tree::null)
+
+public:
+    explicit BinaryTrees_Durable(const std::string& path, size_t checkpointEvery = 0): path(path), checkpointEvery(checkpointEvery)
+    {
+        logFile = ::open((path + ".log").c_str(), O_RDWR);
+        bool created = (logFile < 0 && errno == ENOENT);
+        if(created)
+            logFile = ::open((path + ".log").c_str(), O_RDWR | O_CREAT, 0644);
+        if(logFile < 0)
+            throw std::runtime_error("Can't open the log of the tree: " + path + ".log");
+
+        try
         {
-            throw std::out_of_range("Out of range! Node not found in the three..."); //Выкидываем исключение, с выводом сообщения об ошибке, либо:
-            //or
-            //std::cout << " <<  Warning! No data was found! Instead of the data, the empty stub is returned...  >> " << std::endl;
-            //return new typename Tree::Node(0, new T()); //Возращаем пустую заглушку
+            if(created)
+                sync_directory(path + ".log");
+            recover();
         }
+        catch(...)
+        {
+            ::close(logFile);
+            throw;
+        }
+    }
+    BinaryTrees_Durable(const BinaryTrees_Durable&) = delete;
+    BinaryTrees_Durable& operator = (const BinaryTrees_Durable&) = delete;
+    ~BinaryTrees_Durable()
+    {
+        std::unique_lock<std::mutex> lock(logMutex);
+        try
+        {
+            commit(lock, lastSequence);
+        }
+        catch(...)
+        {
 
-        ThreadSafe_OFF
-
-        return node;
+        }
+        ::close(logFile);
     }
 
-    int size()
+    int append(T data)
     {
-        ThreadSafe_ON
-
-        int size = Tree::getSizeTree(tree);
+        std::unique_lock<std::mutex> lock(logMutex);
 
-        ThreadSafe_OFF
+        int key = nextKey++;
+        tree.insert(key, data);
+        commit(lock, log(Insert, key, data));
 
-        return size;
+        return key;
     }
-    void printTree()
+
+    bool insert(int key, T data)
     {
-        ThreadSafe_ON
+        std::unique_lock<std::mutex> lock(logMutex);
 
-        Tree::printTree(tree);
+        if(!tree.insert(key, data))
+            return false;
+        if(key >= nextKey)
+            nextKey = key + 1;
+        commit(lock, log(Insert, key, data));
 
-        ThreadSafe_OFF
+        return true;
     }
 
     void remove(int key)
     {
-        ThreadSafe_ON
+        std::unique_lock<std::mutex> lock(logMutex);
 
-        Tree::remove(tree, key);
+        if(!tree.contains(key))
+            return;
+        tree.remove(key);
+        commit(lock, log(Remove, key, T()));
+    }
 
-        if(is_tree_empty())
-            tree = Tree::null;
+    void checkpoint()
+    {
+        std::unique_lock<std::mutex> lock(logMutex);
+        checkpoint_process(lock);
+    }
 
-        ThreadSafe_OFF
+    //Reading does not touch the log:
+    std::optional<T> find(int key)
+    {
+        return tree.find(key);
     }
-    void deleteTree()
+
+    bool contains(int key)
     {
-        ThreadSafe_ON
+        return tree.contains(key);
+    }
 
-        Tree::deleteTree(tree);
-        tree = Tree::null;
+    T get_or(int key, T default_data)
+    {
+        return tree.get_or(key, default_data);
+    }
 
-        ThreadSafe_OFF
+    template <class Func> void forEach(Func visit)
+    {
+        tree.forEach(visit);
+    }
+
+    int size()
+    {
+        return tree.size();
+    }
+
+    bool validate()
+    {
+        return tree.validate();
+    }
+
+    void printTree()
+    {
+        tree.printTree();
     }
 };
+#endif
 
 }
 
@@ -1333,6 +7416,19 @@ namespace abt{//abt - Access to Binary Trees
 template<typename T> using SearchTree = BinaryTrees::BinaryTrees_API <T>;
 template<typename T> using ABLTree = BinaryTrees::BinaryTrees_API <T, BinaryTrees::BinaryABLTree<T>>;
 template<typename T> using RedBlackTree = BinaryTrees::BinaryTrees_API <T, BinaryTrees::BinaryRedBlackTree<T>>;
+template<typename T> using CompactRedBlackTree = BinaryTrees::BinaryTrees_API <T, BinaryTrees::BinaryCompactRedBlackTree<T>>;
+template<typename T> using PersistentTree = BinaryTrees::BinaryTrees_API <T, BinaryTrees::BinaryPersistentTree<T>>;
+template<typename T> using CachedSearchTree = BinaryTrees::BinaryTrees_API <T, BinaryTrees::BinarySearchTree<T>, BinaryTrees::ThreadingModel::SingleThreaded, BinaryTrees::LookupCache::DirectMapped<>>;
+template<typename T> using LazyABLTree = BinaryTrees::BinaryTrees_API <T, BinaryTrees::BinaryABLTree<T, BinaryTrees::Deletion::Lazy<>>>;
+template<typename T> using LazyRedBlackTree = BinaryTrees::BinaryTrees_API <T, BinaryTrees::BinaryRedBlackTree<T, BinaryTrees::Augmentation::None, BinaryTrees::Deletion::Lazy<>>>;
+template<typename T> using CachedABLTree = BinaryTrees::BinaryTrees_API <T, BinaryTrees::BinaryABLTree<T>, BinaryTrees::ThreadingModel::SingleThreaded, BinaryTrees::LookupCache::DirectMapped<>>;
+template<typename T> using CachedRedBlackTree = BinaryTrees::BinaryTrees_API <T, BinaryTrees::BinaryRedBlackTree<T>, BinaryTrees::ThreadingModel::SingleThreaded, BinaryTrees::LookupCache::DirectMapped<>>;
+template<typename T> using SplayTree = BinaryTrees::BinaryTrees_API <T, BinaryTrees::BinarySplayTree<T>>;
+template<typename T> using LazySplayTree = BinaryTrees::BinaryTrees_API <T, BinaryTrees::BinarySplayTree<T, 8>>;
+template<typename T> using IntervalTree = BinaryTrees::BinaryTrees_API <BinaryTrees::Interval<T>, BinaryTrees::BinaryRedBlackTree<BinaryTrees::Interval<T>, BinaryTrees::Augmentation::Intervals>>;
+template<typename T> using LeanRedBlackTree = BinaryTrees::BinaryTrees_API <T, BinaryTrees::BinaryRedBlackTree<T>, BinaryTrees::ThreadingModel::SingleThreaded, BinaryTrees::LookupCache::None, BinaryTrees::TreeTraits::Lean>;
+template<typename T> using BoundedRedBlackTree = BinaryTrees::BinaryTrees_API <T, BinaryTrees::BinaryRedBlackTree<T>, BinaryTrees::ThreadingModel::SingleThreaded, BinaryTrees::LookupCache::None, BinaryTrees::TreeTraits::Bounded>;
+template<typename T> using HugePageRedBlackTree = BinaryTrees::BinaryTrees_API <T, BinaryTrees::BinaryRedBlackTree<T, BinaryTrees::Augmentation::None, BinaryTrees::Deletion::Immediate, BinaryTrees::Values::HugePageNodes<>>>;
 
 
 /* * * * * * * * * * * * * * * * * * * * * * *
@@ -1341,6 +7437,50 @@ template<typename T> using RedBlackTree = BinaryTrees::BinaryTrees_API <T, Binar
 template<typename T> using SearchThree_p = BinaryTrees::BinaryTrees_API <T, BinaryTrees::BinarySearchTree<T>, BinaryTrees::ThreadingModel::ObjectLevelLockable>;
 template<typename T> using ABLTree_p = BinaryTrees::BinaryTrees_API <T, BinaryTrees::BinaryABLTree<T>, BinaryTrees::ThreadingModel::ObjectLevelLockable>;
 template<typename T> using RedBlackTree_p = BinaryTrees::BinaryTrees_API <T, BinaryTrees::BinaryRedBlackTree<T>, BinaryTrees::ThreadingModel::ObjectLevelLockable>;
+template<typename T> using CompactRedBlackTree_p = BinaryTrees::BinaryTrees_API <T, BinaryTrees::BinaryCompactRedBlackTree<T>, BinaryTrees::ThreadingModel::ObjectLevelLockable>;
+template<typename T> using PersistentTree_p = BinaryTrees::BinaryTrees_API <T, BinaryTrees::BinaryPersistentTree<T>, BinaryTrees::ThreadingModel::ObjectLevelLockable>;
+template<typename T> using EpochTree_p = BinaryTrees::BinaryTrees_API <T, BinaryTrees::BinaryPersistentTree<T, BinaryTrees::Reclamation::Epochs<>>, BinaryTrees::ThreadingModel::ObjectLevelLockable>;
+template<typename T> using CachedSearchTree_p = BinaryTrees::BinaryTrees_API <T, BinaryTrees::BinarySearchTree<T>, BinaryTrees::ThreadingModel::ObjectLevelLockable, BinaryTrees::LookupCache::DirectMapped<>>;
+template<typename T> using LazyABLTree_p = BinaryTrees::BinaryTrees_API <T, BinaryTrees::BinaryABLTree<T, BinaryTrees::Deletion::Lazy<>>, BinaryTrees::ThreadingModel::ObjectLevelLockable>;
+template<typename T> using LazyRedBlackTree_p = BinaryTrees::BinaryTrees_API <T, BinaryTrees::BinaryRedBlackTree<T, BinaryTrees::Augmentation::None, BinaryTrees::Deletion::Lazy<>>, BinaryTrees::ThreadingModel::ObjectLevelLockable>;
+template<typename T> using CachedABLTree_p = BinaryTrees::BinaryTrees_API <T, BinaryTrees::BinaryABLTree<T>, BinaryTrees::ThreadingModel::ObjectLevelLockable, BinaryTrees::LookupCache::DirectMapped<>>;
+template<typename T> using CachedRedBlackTree_p = BinaryTrees::BinaryTrees_API <T, BinaryTrees::BinaryRedBlackTree<T>, BinaryTrees::ThreadingModel::ObjectLevelLockable, BinaryTrees::LookupCache::DirectMapped<>>;
+template<typename T> using SplayTree_p = BinaryTrees::BinaryTrees_API <T, BinaryTrees::BinarySplayTree<T>, BinaryTrees::ThreadingModel::ObjectLevelLockable>;
+template<typename T> using LazySplayTree_p = BinaryTrees::BinaryTrees_API <T, BinaryTrees::BinarySplayTree<T, 8>, BinaryTrees::ThreadingModel::ObjectLevelLockable>;
+template<typename T> using IntervalTree_p = BinaryTrees::BinaryTrees_API <BinaryTrees::Interval<T>, BinaryTrees::BinaryRedBlackTree<BinaryTrees::Interval<T>, BinaryTrees::Augmentation::Intervals>, BinaryTrees::ThreadingModel::ObjectLevelLockable>;
+template<typename T> using BoundedRedBlackTree_p = BinaryTrees::BinaryTrees_API <T, BinaryTrees::BinaryRedBlackTree<T>, BinaryTrees::ThreadingModel::ObjectLevelLockable, BinaryTrees::LookupCache::None, BinaryTrees::TreeTraits::Bounded>;
+template<typename T> using NumaRedBlackTree_p = BinaryTrees::BinaryTrees_API <T, BinaryTrees::BinaryRedBlackTree<T, BinaryTrees::Augmentation::None, BinaryTrees::Deletion::Immediate, BinaryTrees::Values::NumaLocal<>>, BinaryTrees::ThreadingModel::ObjectLevelLockable>;
+template<typename T> using HugePageRedBlackTree_p = BinaryTrees::BinaryTrees_API <T, BinaryTrees::BinaryRedBlackTree<T, BinaryTrees::Augmentation::None, BinaryTrees::Deletion::Immediate, BinaryTrees::Values::HugePageNodes<>>, BinaryTrees::ThreadingModel::ObjectLevelLockable>;
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * *  Sharded_p - N trees with their own locks, for  * *
+ * *  parallel writers                               * *
+   * * * * * * * * * * * * * * * * * * * * * * * * * * */
+template<typename T> using ShardedSearchTree_p = BinaryTrees::BinaryTrees_Sharded <T, BinaryTrees::BinarySearchTree<T>, BinaryTrees::ThreadingModel::ObjectLevelLockable>;
+template<typename T> using ShardedABLTree_p = BinaryTrees::BinaryTrees_Sharded <T, BinaryTrees::BinaryABLTree<T>, BinaryTrees::ThreadingModel::ObjectLevelLockable>;
+template<typename T> using ShardedRedBlackTree_p = BinaryTrees::BinaryTrees_Sharded <T, BinaryTrees::BinaryRedBlackTree<T>, BinaryTrees::ThreadingModel::ObjectLevelLockable>;
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * *  Replicated_p - a replica of the tree on every  * *
+ * *  NUMA node, the readers use the local one       * *
+   * * * * * * * * * * * * * * * * * * * * * * * * * * */
+template<typename T> using ReplicatedRedBlackTree_p = BinaryTrees::BinaryTrees_Replicated <T>;
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * *  Strings - trees with std::string keys and      * *
+ * *  ordered, prefix and range scans                * *
+   * * * * * * * * * * * * * * * * * * * * * * * * * * */
+template<typename T> using StringTree = BinaryTrees::BinaryTrees_Strings <T>;
+template<typename T> using StringTree_p = BinaryTrees::BinaryTrees_Strings <T, BinaryTrees::BinaryRadixTree<T>, BinaryTrees::ThreadingModel::ObjectLevelLockable>;
+
+#ifdef BINARY_TREES_DURABLE
+/* * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * *  Durable_p - the tree is kept in a log on disk  * *
+ * *  and recovered by the constructor from it       * *
+   * * * * * * * * * * * * * * * * * * * * * * * * * * */
+template<typename T> using DurableABLTree_p = BinaryTrees::BinaryTrees_Durable <T, BinaryTrees::BinaryABLTree<T>, BinaryTrees::ThreadingModel::ObjectLevelLockable>;
+template<typename T> using DurableRedBlackTree_p = BinaryTrees::BinaryTrees_Durable <T, BinaryTrees::BinaryRedBlackTree<T>, BinaryTrees::ThreadingModel::ObjectLevelLockable>;
+#endif
 
 }
 
@@ -0,0 +1,442 @@
+#include "binarytrees.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * *  Replay of a recorded workload against one of the abt:: trees:            * *
+ * *    replay --tree <name> [--threads N] [--timed] [--validate]              * *
+ * *           [--min-ops R] <trace file>                                      * *
+ * *  The trace has one operation per line (# starts a comment):               * *
+ * *    <op> <key> <value> [<time, us>]                                        * *
+ * *      i - insert(key, value)     a - append(value), the key is ignored     * *
+ * *      s - search(key)            r - remove(key), the value is ignored     * *
+ * *  The operations on key k are replayed by the thread k mod N in the order  * *
+ * *  of the trace, and all appends by thread 0, so every key gets the same    * *
+ * *  sequence of operations in every run and the final tree is the same. Only * *
+ * *  the keys handed out by append() may depend on the timing of the threads, * *
+ * *  when the trace also inserts keys above them. With --timed every          * *
+ * *  operation waits for its time from the start of the trace, otherwise the  * *
+ * *  operations go one after another.                                         * *
+ * *  Reported per type of operation: throughput, latency percentiles and,     * *
+ * *  where perf_event_open() is allowed, the user-space instructions, cache   * *
+ * *  misses, dTLB load misses (n/a where the CPU has no such event) and       * *
+ * *  branch misses of the operation itself (the HugePage trees should show    * *
+ * *  fewer dTLB misses). As a gate for stress runs the exit code is 1 if      * *
+ * *  --validate finds the tree broken at the end, or if the whole replay is   * *
+ * *  slower than R operations per second                                      * *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+   * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+namespace {
+
+enum OperationKind { Insert, Append, Search, Remove, OperationKinds };
+const char* operationNames[OperationKinds] = {"insert", "append", "search", "remove"};
+
+struct Operation
+{
+    OperationKind kind;
+    int key;
+    int value;
+    long long time; //us from the start of the trace
+};
+
+struct Options
+{
+    std::string tree;
+    std::string trace;
+    int threads = 1;
+    bool timed = false;
+    bool validate = false;
+    double minOps = 0;
+};
+
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * *
+ * *  Counters of the calling thread, read as one  * *
+ * *  group; the kernel part (the read itself) is  * *
+ * *  not counted. The optional ones are opened    * *
+ * *  alone, so a CPU without them loses only them * *
+   * * * * * * * * * * * * * * * * * * * * * * * * */
+class PerfCounters
+{
+public:
+    enum { Instructions, CacheMisses, TlbMisses, BranchMisses, Count };
+    static constexpr const char* names[Count] = {"instructions", "cache-misses", "dtlb-misses", "branch-misses"};
+    static constexpr bool optional[Count] = {false, false, true, false}; //Many CPUs and VMs have no dTLB cache event
+
+    PerfCounters()
+    {
+#ifdef __linux__
+        const uint32_t types[Count] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE};
+        const uint64_t configs[Count] = {PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES,
+                                         PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+                                         PERF_COUNT_HW_BRANCH_MISSES};
+
+        for(int i = 0; i < Count; i++)
+        {
+            bool leader = (leader_ < 0 && !optional[i]);
+
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = types[i];
+            attr.config = configs[i];
+            attr.disabled = (leader || optional[i]);
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = optional[i] ? 0 : PERF_FORMAT_GROUP;
+
+            fds_[i] = int(syscall(__NR_perf_event_open, &attr, 0, -1, (leader || optional[i]) ? -1 : leader_, 0));
+            if(fds_[i] < 0 && optional[i])
+                continue;
+            if(fds_[i] < 0)
+            {
+                close_all();
+                return;
+            }
+
+            if(leader) leader_ = fds_[i];
+            if(!optional[i]) grouped_++;
+        }
+
+        for(int i = 0; i < Count; i++)
+            if(fds_[i] == leader_ || (optional[i] && fds_[i] >= 0))
+            {
+                ioctl(fds_[i], PERF_EVENT_IOC_RESET, optional[i] ? 0 : PERF_IOC_FLAG_GROUP);
+                ioctl(fds_[i], PERF_EVENT_IOC_ENABLE, optional[i] ? 0 : PERF_IOC_FLAG_GROUP);
+            }
+        available_ = true;
+#endif
+    }
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator = (const PerfCounters&) = delete;
+    ~PerfCounters()
+    {
+        close_all();
+    }
+
+    //False for all counters if the group can't be opened, for an optional one if only it can't:
+    bool available(int counter)
+    {
+        return available_ && fds_[counter] >= 0;
+    }
+
+    void read(uint64_t values[Count])
+    {
+        std::memset(values, 0, sizeof(uint64_t) * Count);
+#ifdef __linux__
+        struct { uint64_t count; uint64_t values[Count]; } group;
+        if(!available_ || ::read(leader_, &group, sizeof(group)) != ssize_t(sizeof(uint64_t) * (1 + grouped_)))
+            return;
+
+        int member = 0;
+        for(int i = 0; i < Count; i++)
+        {
+            if(!optional[i]) values[i] = group.values[member++];
+            else if(fds_[i] >= 0 && ::read(fds_[i], &values[i], sizeof(uint64_t)) != ssize_t(sizeof(uint64_t))) values[i] = 0;
+        }
+#endif
+    }
+
+private:
+    int fds_[Count] = {-1, -1, -1, -1};
+    int leader_ = -1;
+    int grouped_ = 0; //Counters read through the leader
+    bool available_ = false;
+
+    void close_all()
+    {
+#ifdef __linux__
+        for(int& fd : fds_)
+        {
+            if(fd >= 0) close(fd);
+            fd = -1;
+        }
+#endif
+        leader_ = -1;
+        grouped_ = 0;
+        available_ = false;
+    }
+};
+
+struct Statistics
+{
+    std::vector<long long> latencies[OperationKinds]; //ns
+    uint64_t counters[OperationKinds][PerfCounters::Count] = {};
+    bool countersAvailable[PerfCounters::Count] = {};
+};
+
+
+bool parseTrace(const std::string& path, std::vector<Operation>& operations)
+{
+    std::ifstream in(path);
+    if(!in)
+    {
+        std::cerr << "Can't open the trace " << path << std::endl;
+        return false;
+    }
+
+    std::string line;
+    for(int number = 1; std::getline(in, line); number++)
+    {
+        if(line.empty() || line[0] == '#') continue;
+
+        std::istringstream fields(line);
+        char op;
+        Operation operation{Insert, 0, 0, 0};
+        if(!(fields >> op >> operation.key >> operation.value))
+        {
+            std::cerr << "Bad operation in line " << number << ": " << line << std::endl;
+            return false;
+        }
+        fields >> operation.time;
+
+        switch(op)
+        {
+        case 'i': operation.kind = Insert; break;
+        case 'a': operation.kind = Append; break;
+        case 's': operation.kind = Search; break;
+        case 'r': operation.kind = Remove; break;
+        default:
+            std::cerr << "Unknown operation '" << op << "' in line " << number << std::endl;
+            return false;
+        }
+
+        operations.push_back(operation);
+    }
+
+    return true;
+}
+
+//All operations on one key go to one thread; append() takes its keys from one sequence, so all appends go to thread 0:
+size_t threadOf(const Operation& operation, int threads)
+{
+    if(operation.kind == Append) return 0;
+    return size_t((operation.key % threads + threads) % threads);
+}
+
+template <class Tree> void replayThread(Tree& tree, const std::vector<Operation>& operations, const std::vector<size_t>& assigned, const Options& options, std::chrono::steady_clock::time_point start, Statistics& statistics)
+{
+    PerfCounters counters;
+    for(int c = 0; c < PerfCounters::Count; c++)
+        statistics.countersAvailable[c] = counters.available(c);
+
+    uint64_t before[PerfCounters::Count], after[PerfCounters::Count];
+    long long firstTime = operations.empty() ? 0 : operations.front().time;
+    volatile int sink = 0;
+
+    for(size_t i : assigned)
+    {
+        const Operation& operation = operations[i];
+        if(options.timed)
+            std::this_thread::sleep_until(start + std::chrono::microseconds(operation.time - firstTime));
+
+        counters.read(before);
+        auto begin = std::chrono::steady_clock::now();
+
+        switch(operation.kind)
+        {
+        case Insert: tree.insert(operation.key, operation.value); break;
+        case Append: sink = tree.append(operation.value); break;
+        case Search: sink = tree.find(operation.key).value_or(0); break;
+        case Remove: tree.remove(operation.key); break;
+        default: break;
+        }
+
+        auto end = std::chrono::steady_clock::now();
+        counters.read(after);
+
+        statistics.latencies[operation.kind].push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count());
+        for(int c = 0; c < PerfCounters::Count; c++)
+            statistics.counters[operation.kind][c] += after[c] - before[c];
+    }
+    (void)sink;
+}
+
+void report(std::vector<Statistics>& statistics, double seconds)
+{
+    bool available[PerfCounters::Count], countersAvailable = false;
+    for(int c = 0; c < PerfCounters::Count; c++)
+    {
+        available[c] = true;
+        for(Statistics& thread : statistics)
+            available[c] = available[c] && thread.countersAvailable[c];
+        countersAvailable = countersAvailable || available[c];
+    }
+
+    std::printf("%-8s %10s %12s %9s %9s %9s %9s %9s", "op", "count", "ops/s", "p50 ns", "p90 ns", "p99 ns", "p99.9 ns", "max ns");
+    if(countersAvailable)
+        for(const char* name : PerfCounters::names) std::printf(" %15s", name);
+    std::printf("\n");
+
+    for(int kind = 0; kind < OperationKinds; kind++)
+    {
+        std::vector<long long> latencies;
+        uint64_t counters[PerfCounters::Count] = {};
+        for(Statistics& thread : statistics)
+        {
+            latencies.insert(latencies.end(), thread.latencies[kind].begin(), thread.latencies[kind].end());
+            for(int c = 0; c < PerfCounters::Count; c++) counters[c] += thread.counters[kind][c];
+        }
+        if(latencies.empty()) continue;
+
+        std::sort(latencies.begin(), latencies.end());
+        auto percentile = [&latencies](double p) { return latencies[std::min(latencies.size() - 1, size_t(p * double(latencies.size())))]; };
+
+        std::printf("%-8s %10zu %12.0f %9lld %9lld %9lld %9lld %9lld", operationNames[kind], latencies.size(), double(latencies.size()) / seconds,
+                    percentile(0.5), percentile(0.9), percentile(0.99), percentile(0.999), latencies.back());
+        if(countersAvailable)
+            for(int c = 0; c < PerfCounters::Count; c++)
+            {
+                if(available[c]) std::printf(" %15.1f", double(counters[c]) / double(latencies.size())); //per operation
+                else std::printf(" %15s", "n/a");
+            }
+        std::printf("\n");
+    }
+
+    if(!countersAvailable)
+        std::printf("perf_event_open() is not available (see /proc/sys/kernel/perf_event_paranoid): no counters\n");
+}
+
+template <class Tree> int replay(const Options& options, const std::vector<Operation>& operations)
+{
+    Tree tree;
+    std::vector<Statistics> statistics(size_t(options.threads));
+    std::vector<std::thread> threads;
+
+    std::vector<std::vector<size_t>> assigned(size_t(options.threads));
+    for(size_t i = 0; i < operations.size(); i++)
+        assigned[threadOf(operations[i], options.threads)].push_back(i);
+
+    auto start = std::chrono::steady_clock::now();
+    for(int thread = 0; thread < options.threads; thread++)
+        threads.emplace_back(replayThread<Tree>, std::ref(tree), std::cref(operations), std::cref(assigned[size_t(thread)]), std::cref(options), start, std::ref(statistics[size_t(thread)]));
+    for(std::thread& thread : threads)
+        thread.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::printf("%s, %d thread(s): %zu operations in %.3f s (%.0f ops/s), %d nodes at the end\n", options.tree.c_str(), options.threads,
+                operations.size(), seconds, double(operations.size()) / seconds, tree.size());
+    report(statistics, seconds);
+
+    int result = 0;
+    if(options.validate)
+    {
+        bool valid = tree.validate();
+        std::printf("validate: %s\n", valid ? "the tree is consistent" : "THE TREE IS BROKEN");
+        if(!valid) result = 1;
+    }
+    if(double(operations.size()) / seconds < options.minOps)
+    {
+        std::printf("throughput gate: %.0f ops/s is below %.0f ops/s\n", double(operations.size()) / seconds, options.minOps);
+        result = 1;
+    }
+
+    return result;
+}
+
+struct Backend
+{
+    const char* name;
+    bool threadSafe;
+    int (*replay)(const Options&, const std::vector<Operation>&);
+};
+
+const Backend backends[] = {
+    {"SearchTree", false, replay<abt::SearchTree<int>>},
+    {"ABLTree", false, replay<abt::ABLTree<int>>},
+    {"RedBlackTree", false, replay<abt::RedBlackTree<int>>},
+    {"CompactRedBlackTree", false, replay<abt::CompactRedBlackTree<int>>},
+    {"PersistentTree", false, replay<abt::PersistentTree<int>>},
+    {"SplayTree", false, replay<abt::SplayTree<int>>},
+    {"LazySplayTree", false, replay<abt::LazySplayTree<int>>},
+    {"LazyABLTree", false, replay<abt::LazyABLTree<int>>},
+    {"LazyRedBlackTree", false, replay<abt::LazyRedBlackTree<int>>},
+    {"LeanRedBlackTree", false, replay<abt::LeanRedBlackTree<int>>},
+    {"BoundedRedBlackTree", false, replay<abt::BoundedRedBlackTree<int>>},
+    {"HugePageRedBlackTree", false, replay<abt::HugePageRedBlackTree<int>>},
+    {"CachedSearchTree", false, replay<abt::CachedSearchTree<int>>},
+    {"CachedABLTree", false, replay<abt::CachedABLTree<int>>},
+    {"CachedRedBlackTree", false, replay<abt::CachedRedBlackTree<int>>},
+    {"SearchTree_p", true, replay<abt::SearchThree_p<int>>},
+    {"ABLTree_p", true, replay<abt::ABLTree_p<int>>},
+    {"RedBlackTree_p", true, replay<abt::RedBlackTree_p<int>>},
+    {"CompactRedBlackTree_p", true, replay<abt::CompactRedBlackTree_p<int>>},
+    {"PersistentTree_p", true, replay<abt::PersistentTree_p<int>>},
+    {"EpochTree_p", true, replay<abt::EpochTree_p<int>>},
+    {"SplayTree_p", true, replay<abt::SplayTree_p<int>>},
+    {"LazySplayTree_p", true, replay<abt::LazySplayTree_p<int>>},
+    {"LazyABLTree_p", true, replay<abt::LazyABLTree_p<int>>},
+    {"LazyRedBlackTree_p", true, replay<abt::LazyRedBlackTree_p<int>>},
+    {"BoundedRedBlackTree_p", true, replay<abt::BoundedRedBlackTree_p<int>>},
+    {"NumaRedBlackTree_p", true, replay<abt::NumaRedBlackTree_p<int>>},
+    {"HugePageRedBlackTree_p", true, replay<abt::HugePageRedBlackTree_p<int>>},
+    {"CachedSearchTree_p", true, replay<abt::CachedSearchTree_p<int>>},
+    {"CachedABLTree_p", true, replay<abt::CachedABLTree_p<int>>},
+    {"CachedRedBlackTree_p", true, replay<abt::CachedRedBlackTree_p<int>>},
+    {"ShardedSearchTree_p", true, replay<abt::ShardedSearchTree_p<int>>},
+    {"ShardedABLTree_p", true, replay<abt::ShardedABLTree_p<int>>},
+    {"ShardedRedBlackTree_p", true, replay<abt::ShardedRedBlackTree_p<int>>},
+    {"ReplicatedRedBlackTree_p", true, replay<abt::ReplicatedRedBlackTree_p<int>>},
+};
+
+int usage()
+{
+    std::cerr << "Usage: replay --tree <name> [--threads N] [--timed] [--validate] [--min-ops R] <trace file>" << std::endl << "Trees:";
+    for(const Backend& backend : backends)
+        std::cerr << " " << backend.name;
+    std::cerr << std::endl;
+
+    return 2;
+}
+
+}
+
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    for(int i = 1; i < argc; i++)
+    {
+        std::string argument = argv[i];
+        if(argument == "--tree" && i + 1 < argc) options.tree = argv[++i];
+        else if(argument == "--threads" && i + 1 < argc) options.threads = std::atoi(argv[++i]);
+        else if(argument == "--timed") options.timed = true;
+        else if(argument == "--validate") options.validate = true;
+        else if(argument == "--min-ops" && i + 1 < argc) options.minOps = std::atof(argv[++i]);
+        else if(argument[0] != '-' && options.trace.empty()) options.trace = argument;
+        else return usage();
+    }
+    if(options.tree.empty() || options.trace.empty() || options.threads < 1)
+        return usage();
+
+    const Backend* backend = nullptr;
+    for(const Backend& candidate : backends)
+        if(options.tree == candidate.name) backend = &candidate;
+    if(backend == nullptr)
+        return usage();
+    if(options.threads > 1 && !backend->threadSafe)
+    {
+        std::cerr << options.tree << " is not thread-safe: use one of the _p trees for --threads " << options.threads << std::endl;
+        return 2;
+    }
+
+    std::vector<Operation> operations;
+    if(!parseTrace(options.trace, operations))
+        return 1;
+
+    return backend->replay(options, operations);
+}
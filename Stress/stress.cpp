@@ -0,0 +1,735 @@
+#include "binarytrees.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * *  Randomized differential check of the abt:: trees against std::map:     * *
+ * *    stress [--tree <name>] [--seed S] [--ops K] [--keys R] [--threads N] * *
+ * *           [--min-ops M]                                                 * *
+ * *  single: every tree runs K operations drawn from the seed - insert,     * *
+ * *    remove, upsert, update, emplace, append, find, contains, get_or and, * *
+ * *    for the AVL and red-black trees, split/join/merge between two trees  * *
+ * *    and deleteTree - and every result is compared with a std::map model  * *
+ * *    of the same tree (with the sequence of append() keys). The contents, * *
+ * *    size() and validate() are compared every 1000 operations and at the  * *
+ * *    end                                                                  * *
+ * *  strings: StringTree and StringTree_p run the same mix on string keys   * *
+ * *    built from a few shared stems and short tails, with the empty key    * *
+ * *    and bytes >= 0x80 among them, and compare forEachPrefix() and        * *
+ * *    forEachRange() with the same walks over a std::map<std::string, int> * *
+ * *  durable: the Durable_p trees run insert, remove, append and the reads  * *
+ * *    in a fresh directory under $TMPDIR, with checkpoint() now and then,  * *
+ * *    some of the reopens with checkpointEvery > 0. The tree is destroyed  * *
+ * *    and recovered from its files, sometimes after a few bytes are cut    * *
+ * *    off the log or a byte of one of its records is flipped: then the     * *
+ * *    model takes back that record and all after it, and the recovered    * *
+ * *    tree must match it                                                   * *
+ * *  threaded: N threads run K operations each on one _p tree. A thread     * *
+ * *    owns the negative keys -1 - t - N*j, so its own std::map predicts    * *
+ * *    every result, while append() takes positive keys of any thread. At   * *
+ * *    the end the tree must hold the union of the maps                     * *
+ * *  The first difference is printed with the seed and the number of the    * *
+ * *  operation. The exit code is 1 on any difference, or if a threaded run  * *
+ * *  is slower than M operations per second, so the target works as a gate  * *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+   * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+namespace {
+
+struct Options
+{
+    std::string tree;
+    unsigned seed = 1;
+    long ops = 200000;
+    int keys = 2000;
+    int threads = 4;
+    double minOps = 0;
+};
+
+//What one tree must hold, and the key its next append() must return:
+struct Model
+{
+    std::map<int, int> keys;
+    int nextKey = 1;
+
+    void reserve(int key)
+    {
+        if(key >= nextKey) nextKey = key + 1;
+    }
+};
+
+class Checker
+{
+    const char* name_;
+    const Options& options_;
+    long operation_ = 0;
+    bool passed_ = true;
+
+public:
+    Checker(const char* name, const Options& options): name_(name), options_(options)
+    {
+
+    }
+
+    void at(long operation)
+    {
+        operation_ = operation;
+    }
+
+    //Only the first difference is printed, the later ones usually follow from it:
+    bool expect(bool condition, const char* what, int key)
+    {
+        return report(condition, what, std::to_string(key));
+    }
+
+    //The bytes outside of printable ASCII are shown as \xNN:
+    bool expect(bool condition, const char* what, const std::string& key)
+    {
+        std::string shown = "\"";
+        for(unsigned char byte : key)
+        {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), (byte >= 0x20 && byte < 0x7f && byte != '\\' && byte != '"') ? "%c" : "\\x%02x", byte);
+            shown += escaped;
+        }
+
+        return report(condition, what, shown + "\"");
+    }
+
+    bool passed()
+    {
+        return passed_;
+    }
+
+private:
+    bool report(bool condition, const char* what, const std::string& key)
+    {
+        if(!condition && passed_)
+            std::printf("  %s: %s differs at key %s, operation %ld (--seed %u --ops %ld --keys %d)\n", name_, what, key.c_str(), operation_, options_.seed, options_.ops, options_.keys);
+        passed_ = passed_ && condition;
+        return condition;
+    }
+};
+
+template <class Tree> bool sameContents(Tree& tree, const std::map<int, int>& expected)
+{
+    std::vector<std::pair<int, int>> stored;
+    tree.forEach([&stored](int key, const int& data) { stored.emplace_back(key, data); });
+
+    return stored == std::vector<std::pair<int, int>>(expected.begin(), expected.end());
+}
+
+template <class Tree> void compareWhole(Tree& tree, Model& model, Checker& check)
+{
+    check.expect(tree.validate(), "validate()", 0);
+    check.expect(tree.size() == int(model.keys.size()), "size()", int(model.keys.size()));
+    check.expect(sameContents(tree, model.keys), "content of the tree", 0);
+}
+
+//split/join/merge work on two trees, so the single run keeps a pair of them:
+template <class Tree, bool Restructuring> bool single(const char* name, const Options& options)
+{
+    Checker check(name, options);
+    std::mt19937 random(options.seed);
+    Tree trees[2];
+    Model models[2];
+
+    long i = 0;
+    auto started = std::chrono::steady_clock::now();
+    for(; i < options.ops && check.passed(); i++)
+    {
+        check.at(i);
+
+        int side = int(random() % 4 == 0); //Most of the work goes to the first tree
+        Tree& tree = trees[side];
+        Model& model = models[side];
+        Tree& other = trees[1 - side];
+        Model& otherModel = models[1 - side];
+
+        int key = int(random() % unsigned(options.keys)) - options.keys / 4;
+        int value = int(random() % 1000000);
+        auto found = model.keys.find(key);
+        bool present = (found != model.keys.end());
+
+        unsigned kind = random() % 100;
+        if(kind < 25)
+        {
+            bool inserted = tree.insert(key, value);
+            check.expect(inserted == !present, "insert()", key);
+            if(!present)
+            {
+                model.keys.emplace(key, value);
+                model.reserve(key);
+            }
+        }
+        else if(kind < 42)
+        {
+            tree.remove(key);
+            model.keys.erase(key);
+        }
+        else if(kind < 50)
+        {
+            bool inserted = tree.upsert(key, value);
+            check.expect(inserted == !present, "upsert()", key);
+            model.keys[key] = value;
+            model.reserve(key);
+        }
+        else if(kind < 55)
+        {
+            bool updated = tree.update(key, [](int& data) { data = data * 3 % 1000003; });
+            check.expect(updated == present, "update()", key);
+            if(present) found->second = found->second * 3 % 1000003;
+        }
+        else if(kind < 59)
+        {
+            bool inserted = tree.emplace(key, value);
+            check.expect(inserted == !present, "emplace()", key);
+            if(!present)
+            {
+                model.keys.emplace(key, value);
+                model.reserve(key);
+            }
+        }
+        else if(kind < 65)
+        {
+            int appended = tree.append(value);
+            check.expect(appended == model.nextKey, "the key of append()", appended);
+            model.keys[appended] = value;
+            model.reserve(appended);
+        }
+        else if(kind < 80)
+        {
+            std::optional<int> data = tree.find(key);
+            check.expect(data.has_value() == present && (!present || *data == found->second), "find()", key);
+        }
+        else if(kind < 86)
+            check.expect(tree.contains(key) == present, "contains()", key);
+        else if(kind < 92)
+            check.expect(tree.get_or(key, -1) == (present ? found->second : -1), "get_or()", key);
+        else if(kind < 99)
+        {
+            if constexpr(Restructuring)
+            {
+                unsigned restructuring = random() % 3;
+                if(restructuring == 0) //Keys >= key go to the other tree, whose own nodes are dropped
+                {
+                    tree.split(key, other);
+                    otherModel.keys.clear();
+                    otherModel.keys.insert(model.keys.lower_bound(key), model.keys.end());
+                    model.keys.erase(model.keys.lower_bound(key), model.keys.end());
+                    if(!otherModel.keys.empty()) otherModel.reserve(otherModel.keys.rbegin()->first);
+                }
+                else if(restructuring == 1)
+                {
+                    bool ordered = model.keys.empty() || otherModel.keys.empty() || model.keys.rbegin()->first < otherModel.keys.begin()->first;
+                    check.expect(tree.join(other) == ordered, "join()", key);
+                    if(ordered)
+                    {
+                        model.keys.insert(otherModel.keys.begin(), otherModel.keys.end());
+                        otherModel.keys.clear();
+                        model.reserve(otherModel.nextKey - 1);
+                    }
+                }
+                else //On equal keys the node of this tree stays
+                {
+                    tree.merge(other);
+                    model.keys.insert(otherModel.keys.begin(), otherModel.keys.end());
+                    otherModel.keys.clear();
+                    model.reserve(otherModel.nextKey - 1);
+                }
+            }
+        }
+        else if(random() % 8 == 0)
+        {
+            tree.deleteTree();
+            model = Model();
+        }
+
+        if(i % 1000 == 999)
+            for(int t = 0; t < 2; t++)
+                compareWhole(trees[t], models[t], check);
+    }
+    for(int t = 0; t < 2 && check.passed(); t++)
+        compareWhole(trees[t], models[t], check);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    std::printf("%-26s single    %9ld operations %12.0f ops/s: %s\n", name, i, double(i) / seconds, check.passed() ? "ok" : "FAILED");
+
+    return check.passed();
+}
+
+using Strings = std::vector<std::pair<std::string, int>>;
+
+//Shared stems make the edges split and merge, the empty stem gives the empty key and the tails cross 0x80, which must sort as unsigned:
+std::string randomKey(std::mt19937& random)
+{
+    static const char* const stems[] = {"", "a", "ab", "b\x80", "\xc3\xa9t\xc3\xa9"};
+    static const char tails[] = {'a', 'b', '\x7f', '\x80', '\xff'};
+
+    std::string key = stems[random() % 5];
+    for(unsigned length = random() % 4; length > 0; length--)
+        key += tails[random() % 5];
+
+    return key;
+}
+
+template <class Tree> void compareStrings(Tree& tree, const std::map<std::string, int>& model, Checker& check)
+{
+    Strings stored;
+    tree.forEach([&stored](const std::string& key, const int& data) { stored.emplace_back(key, data); });
+
+    check.expect(tree.validate(), "validate()", 0);
+    check.expect(tree.size() == int(model.size()), "size()", int(model.size()));
+    check.expect(stored == Strings(model.begin(), model.end()), "content of the tree", 0);
+}
+
+template <class Tree> bool strings(const char* name, const Options& options)
+{
+    Checker check(name, options);
+    std::mt19937 random(options.seed);
+    Tree tree;
+    std::map<std::string, int> model;
+
+    long i = 0;
+    auto started = std::chrono::steady_clock::now();
+    for(; i < options.ops && check.passed(); i++)
+    {
+        check.at(i);
+
+        std::string key = randomKey(random);
+        int value = int(random() % 1000000);
+        auto found = model.find(key);
+        bool present = (found != model.end());
+
+        unsigned kind = random() % 100;
+        if(kind < 25)
+        {
+            check.expect(tree.insert(key, value) == !present, "insert()", key);
+            model.emplace(key, value);
+        }
+        else if(kind < 45)
+        {
+            check.expect(tree.remove(key) == present, "remove()", key);
+            model.erase(key);
+        }
+        else if(kind < 53)
+        {
+            check.expect(tree.upsert(key, value) == !present, "upsert()", key);
+            model[key] = value;
+        }
+        else if(kind < 58)
+        {
+            bool updated = tree.update(key, [](int& data) { data = data * 3 % 1000003; });
+            check.expect(updated == present, "update()", key);
+            if(present) found->second = found->second * 3 % 1000003;
+        }
+        else if(kind < 70)
+        {
+            std::optional<int> data = tree.find(key);
+            check.expect(data.has_value() == present && (!present || *data == found->second), "find()", key);
+        }
+        else if(kind < 75)
+            check.expect(tree.contains(key) == present, "contains()", key);
+        else if(kind < 80)
+            check.expect(tree.get_or(key, -1) == (present ? found->second : -1), "get_or()", key);
+        else if(kind < 89) //The key is the prefix, so the empty prefix visits the whole tree
+        {
+            Strings visited, expected;
+            tree.forEachPrefix(key, [&visited](const std::string& stored, const int& data) { visited.emplace_back(stored, data); });
+            for(auto it = model.lower_bound(key); it != model.end() && it->first.compare(0, key.size(), key) == 0; ++it)
+                expected.push_back(*it);
+            check.expect(visited == expected, "forEachPrefix()", key);
+        }
+        else if(kind < 98) //Half of the ranges are empty or reversed
+        {
+            std::string high = randomKey(random);
+            Strings visited, expected;
+            tree.forEachRange(key, high, [&visited](const std::string& stored, const int& data) { visited.emplace_back(stored, data); });
+            for(auto it = model.lower_bound(key); it != model.end() && it->first < high; ++it)
+                expected.push_back(*it);
+            check.expect(visited == expected, "forEachRange()", key);
+        }
+        else if(random() % 8 == 0)
+        {
+            tree.deleteTree();
+            model.clear();
+        }
+
+        if(i % 1000 == 999)
+            compareStrings(tree, model, check);
+    }
+    if(check.passed())
+        compareStrings(tree, model, check);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    std::printf("%-26s strings   %9ld operations %12.0f ops/s: %s\n", name, i, double(i) / seconds, check.passed() ? "ok" : "FAILED");
+
+    return check.passed();
+}
+
+#ifdef BINARY_TREES_DURABLE
+//What a record of the log changed, so the model can take it back when recovery drops the record:
+struct Undo
+{
+    int key;
+    std::optional<int> before;
+    int nextKey;
+};
+
+std::vector<char> readFile(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+void writeFile(const std::string& path, const std::vector<char>& bytes)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(bytes.data(), std::streamsize(bytes.size()));
+}
+
+template <class Tree> bool durable(const char* name, const Options& options)
+{
+    const size_t recordSize = 1 + sizeof(int) + sizeof(int) + sizeof(uint32_t); //The operation, the key, the data and the checksum
+
+    Checker check(name, options);
+    std::mt19937 random(options.seed);
+
+    const char* temporary = std::getenv("TMPDIR");
+    std::string directory = std::string(temporary != nullptr && *temporary != '\0' ? temporary : "/tmp") + "/stress-XXXXXX";
+    if(::mkdtemp(&directory[0]) == nullptr)
+    {
+        std::printf("%-26s durable   can't create %s: FAILED\n", name, directory.c_str());
+        return false;
+    }
+    std::string path = directory + "/tree";
+
+    Model model;
+    std::vector<Undo> log; //One entry for each record in the log, which is emptied by a checkpoint
+    size_t checkpointEvery = 0;
+    std::unique_ptr<Tree> tree;
+
+    //The tree checkpoints by itself once the log holds checkpointEvery records, the recovered ones included:
+    auto logged = [&](int key, std::optional<int> before, int nextKey)
+    {
+        log.push_back({key, before, nextKey});
+        if(checkpointEvery > 0 && log.size() >= checkpointEvery)
+            log.clear();
+    };
+    auto reopen = [&]()
+    {
+        tree.reset();
+        checkpointEvery = (random() % 2 == 0) ? 0 : 50 + random() % 200;
+        tree.reset(new Tree(path, checkpointEvery));
+    };
+    //The records from the first one which is dropped on are taken back, the latest first:
+    auto dropFrom = [&](size_t first)
+    {
+        for(; log.size() > first; log.pop_back())
+        {
+            Undo& undo = log.back();
+            if(undo.before) model.keys[undo.key] = *undo.before;
+            else model.keys.erase(undo.key);
+            model.nextKey = undo.nextKey;
+        }
+    };
+
+    long i = 0;
+    auto started = std::chrono::steady_clock::now();
+    try
+    {
+        reopen();
+        for(; i < options.ops && check.passed(); i++)
+        {
+            check.at(i);
+
+            //Now and then the largest key so far, whose removal must not let append() give it out again after a reopen:
+            int key = (random() % 16 == 0) ? model.nextKey - 1 : int(random() % unsigned(options.keys)) - options.keys / 4;
+            int value = int(random() % 1000000);
+            auto found = model.keys.find(key);
+            bool present = (found != model.keys.end());
+
+            unsigned kind = random() % 100;
+            if(kind < 30)
+            {
+                check.expect(tree->insert(key, value) == !present, "insert()", key);
+                if(!present)
+                {
+                    logged(key, std::nullopt, model.nextKey);
+                    model.keys.emplace(key, value);
+                    model.reserve(key);
+                }
+            }
+            else if(kind < 48)
+            {
+                tree->remove(key);
+                if(present)
+                {
+                    logged(key, found->second, model.nextKey);
+                    model.keys.erase(found);
+                }
+            }
+            else if(kind < 56)
+            {
+                int appended = tree->append(value);
+                check.expect(appended == model.nextKey, "the key of append()", appended);
+                logged(appended, std::nullopt, model.nextKey);
+                model.keys[appended] = value;
+                model.reserve(appended);
+            }
+            else if(kind < 74)
+            {
+                std::optional<int> data = tree->find(key);
+                check.expect(data.has_value() == present && (!present || *data == found->second), "find()", key);
+            }
+            else if(kind < 82)
+                check.expect(tree->contains(key) == present, "contains()", key);
+            else if(kind < 90)
+                check.expect(tree->get_or(key, -1) == (present ? found->second : -1), "get_or()", key);
+            else if(kind < 94)
+            {
+                tree->checkpoint();
+                log.clear();
+            }
+            else if(kind < 96)
+            {
+                reopen();
+                compareWhole(*tree, model, check);
+            }
+            else if(kind < 98 && !log.empty()) //A torn write: the last record loses its end
+            {
+                tree.reset();
+                std::vector<char> bytes = readFile(path + ".log");
+                check.expect(bytes.size() == log.size() * recordSize, "size of the log", int(bytes.size()));
+                bytes.resize(bytes.size() - 1 - random() % (recordSize - 1));
+                writeFile(path + ".log", bytes);
+
+                dropFrom(log.size() - 1);
+                reopen();
+                compareWhole(*tree, model, check);
+            }
+            else if(!log.empty()) //A damaged record: recovery stops right before it
+            {
+                tree.reset();
+                std::vector<char> bytes = readFile(path + ".log");
+                check.expect(bytes.size() == log.size() * recordSize, "size of the log", int(bytes.size()));
+                size_t record = random() % log.size();
+                bytes[record * recordSize + random() % recordSize] ^= char(1 << (random() % 8));
+                writeFile(path + ".log", bytes);
+
+                dropFrom(record);
+                reopen();
+                compareWhole(*tree, model, check);
+            }
+
+            if(i % 1000 == 999)
+                compareWhole(*tree, model, check);
+        }
+
+        if(check.passed())
+        {
+            reopen();
+            compareWhole(*tree, model, check);
+        }
+        tree.reset();
+    }
+    catch(const std::exception& error)
+    {
+        std::printf("  %s: %s at operation %ld (--seed %u --ops %ld --keys %d)\n", name, error.what(), i, options.seed, options.ops, options.keys);
+        check.expect(false, "an exception", 0);
+    }
+
+    for(const char* suffix : {".log", ".snapshot", ".snapshot.tmp"})
+        std::remove((path + suffix).c_str());
+    ::rmdir(directory.c_str());
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    std::printf("%-26s durable   %9ld operations %12.0f ops/s: %s\n", name, i, double(i) / seconds, check.passed() ? "ok" : "FAILED");
+
+    return check.passed();
+}
+#endif
+
+template <class Tree> bool threaded(const char* name, const Options& options)
+{
+    Tree tree;
+    std::vector<std::map<int, int>> owned(size_t(options.threads));
+    std::vector<char> passed(size_t(options.threads), 1);
+    int keysPerThread = std::max(1, options.keys / options.threads);
+
+    auto started = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+    for(int t = 0; t < options.threads; t++)
+        threads.emplace_back([&, t]()
+        {
+            Checker check(name, options);
+            std::mt19937 random(options.seed * 7919u + unsigned(t));
+            std::map<int, int>& own = owned[size_t(t)];
+
+            for(long i = 0; i < options.ops && check.passed(); i++)
+            {
+                check.at(i);
+
+                int key = -1 - t - options.threads * int(random() % unsigned(keysPerThread));
+                int value = int(random() % 1000000);
+                auto found = own.find(key);
+                bool present = (found != own.end());
+
+                unsigned kind = random() % 100;
+                if(kind < 25)
+                {
+                    check.expect(tree.insert(key, value) == !present, "insert()", key);
+                    own.emplace(key, value);
+                }
+                else if(kind < 45)
+                {
+                    tree.remove(key);
+                    own.erase(key);
+                }
+                else if(kind < 55)
+                {
+                    check.expect(tree.upsert(key, value) == !present, "upsert()", key);
+                    own[key] = value;
+                }
+                else if(kind < 60)
+                {
+                    int appended = tree.append(value);
+                    check.expect(appended > 0 && own.emplace(appended, value).second, "the key of append()", appended);
+                }
+                else if(kind < 90)
+                {
+                    std::optional<int> data = tree.find(key);
+                    check.expect(data.has_value() == present && (!present || *data == found->second), "find()", key);
+                }
+                else
+                    check.expect(tree.contains(key) == present, "contains()", key);
+            }
+
+            passed[size_t(t)] = check.passed();
+        });
+    for(std::thread& thread : threads)
+        thread.join();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    double throughput = double(options.ops) * options.threads / seconds;
+
+    Checker check(name, options);
+    check.at(options.ops);
+    for(char threadPassed : passed)
+        check.expect(threadPassed, "a thread", 0);
+
+    std::map<int, int> expected;
+    for(std::map<int, int>& own : owned)
+        expected.insert(own.begin(), own.end());
+    check.expect(tree.validate(), "validate()", 0);
+    check.expect(tree.size() == int(expected.size()), "size()", int(expected.size()));
+    check.expect(sameContents(tree, expected), "content of the tree", 0);
+
+    bool fast = (throughput >= options.minOps);
+    std::printf("%-26s %d thread(s) %9ld operations %12.0f ops/s: %s\n", name, options.threads, options.ops * options.threads, throughput,
+                !check.passed() ? "FAILED" : (fast ? "ok" : "BELOW --min-ops"));
+
+    return check.passed() && fast;
+}
+
+struct Backend
+{
+    const char* name;
+    bool (*run)(const char*, const Options&);
+};
+
+const Backend backends[] = {
+    {"SearchTree", single<abt::SearchTree<int>, false>},
+    {"ABLTree", single<abt::ABLTree<int>, true>},
+    {"RedBlackTree", single<abt::RedBlackTree<int>, true>},
+    {"CompactRedBlackTree", single<abt::CompactRedBlackTree<int>, false>},
+    {"PersistentTree", single<abt::PersistentTree<int>, false>},
+    {"SplayTree", single<abt::SplayTree<int>, false>},
+    {"LazySplayTree", single<abt::LazySplayTree<int>, false>},
+    {"LazyABLTree", single<abt::LazyABLTree<int>, true>},
+    {"LazyRedBlackTree", single<abt::LazyRedBlackTree<int>, true>},
+    {"LeanRedBlackTree", single<abt::LeanRedBlackTree<int>, true>},
+    {"BoundedRedBlackTree", single<abt::BoundedRedBlackTree<int>, true>},
+    {"HugePageRedBlackTree", single<abt::HugePageRedBlackTree<int>, true>},
+    {"CachedSearchTree", single<abt::CachedSearchTree<int>, false>},
+    {"CachedABLTree", single<abt::CachedABLTree<int>, true>},
+    {"CachedRedBlackTree", single<abt::CachedRedBlackTree<int>, true>},
+    {"StringTree", strings<abt::StringTree<int>>},
+    {"StringTree_p", strings<abt::StringTree_p<int>>},
+#ifdef BINARY_TREES_DURABLE
+    {"DurableABLTree_p", durable<abt::DurableABLTree_p<int>>},
+    {"DurableRedBlackTree_p", durable<abt::DurableRedBlackTree_p<int>>},
+#endif
+    {"SearchTree_p", threaded<abt::SearchThree_p<int>>},
+    {"ABLTree_p", threaded<abt::ABLTree_p<int>>},
+    {"RedBlackTree_p", threaded<abt::RedBlackTree_p<int>>},
+    {"CompactRedBlackTree_p", threaded<abt::CompactRedBlackTree_p<int>>},
+    {"PersistentTree_p", threaded<abt::PersistentTree_p<int>>},
+    {"EpochTree_p", threaded<abt::EpochTree_p<int>>},
+    {"SplayTree_p", threaded<abt::SplayTree_p<int>>},
+    {"LazySplayTree_p", threaded<abt::LazySplayTree_p<int>>},
+    {"LazyABLTree_p", threaded<abt::LazyABLTree_p<int>>},
+    {"LazyRedBlackTree_p", threaded<abt::LazyRedBlackTree_p<int>>},
+    {"BoundedRedBlackTree_p", threaded<abt::BoundedRedBlackTree_p<int>>},
+    {"NumaRedBlackTree_p", threaded<abt::NumaRedBlackTree_p<int>>},
+    {"HugePageRedBlackTree_p", threaded<abt::HugePageRedBlackTree_p<int>>},
+    {"CachedSearchTree_p", threaded<abt::CachedSearchTree_p<int>>},
+    {"CachedABLTree_p", threaded<abt::CachedABLTree_p<int>>},
+    {"CachedRedBlackTree_p", threaded<abt::CachedRedBlackTree_p<int>>},
+    {"ShardedSearchTree_p", threaded<abt::ShardedSearchTree_p<int>>},
+    {"ShardedABLTree_p", threaded<abt::ShardedABLTree_p<int>>},
+    {"ShardedRedBlackTree_p", threaded<abt::ShardedRedBlackTree_p<int>>},
+    {"ReplicatedRedBlackTree_p", threaded<abt::ReplicatedRedBlackTree_p<int>>},
+};
+
+int usage()
+{
+    std::cerr << "Usage: stress [--tree <name>] [--seed S] [--ops K] [--keys R] [--threads N] [--min-ops M]" << std::endl << "Trees:";
+    for(const Backend& backend : backends)
+        std::cerr << " " << backend.name;
+    std::cerr << std::endl;
+
+    return 2;
+}
+
+}
+
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    for(int i = 1; i < argc; i++)
+    {
+        std::string argument = argv[i];
+        if(argument == "--tree" && i + 1 < argc) options.tree = argv[++i];
+        else if(argument == "--seed" && i + 1 < argc) options.seed = unsigned(std::strtoul(argv[++i], nullptr, 10));
+        else if(argument == "--ops" && i + 1 < argc) options.ops = std::atol(argv[++i]);
+        else if(argument == "--keys" && i + 1 < argc) options.keys = std::atoi(argv[++i]);
+        else if(argument == "--threads" && i + 1 < argc) options.threads = std::atoi(argv[++i]);
+        else if(argument == "--min-ops" && i + 1 < argc) options.minOps = std::atof(argv[++i]);
+        else return usage();
+    }
+    if(options.ops < 0 || options.keys < 1 || options.threads < 1)
+        return usage();
+
+    bool known = options.tree.empty(), passed = true;
+    for(const Backend& backend : backends)
+        if(options.tree.empty() || options.tree == backend.name)
+        {
+            known = true;
+            passed = backend.run(backend.name, options) && passed;
+        }
+    if(!known)
+        return usage();
+
+    return passed ? 0 : 1;
+}